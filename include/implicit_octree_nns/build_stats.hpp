@@ -0,0 +1,135 @@
+#ifndef IMPLICIT_OCTREE_NNS_BUILD_STATS_HPP
+#define IMPLICIT_OCTREE_NNS_BUILD_STATS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <vector>
+
+namespace implicit_octree_nns {
+
+/**
+ * @brief Statistics recorded while constructing a nearest_neighbor, per depth of the octree
+ *
+ * Times spent splitting cells are summed over all construction threads, so with multiple threads
+ * they measure CPU time rather than elapsed time; depth_time and total_time are elapsed times
+ */
+struct build_stats {
+    using duration = std::chrono::nanoseconds;
+
+    /** The time spent in each stage of octree_cell::split_into_children */
+    struct split_timings {
+        /** Finding the octant containing every point of the cell */
+        duration octant_bitmasking{0};
+        /** Building the equation hull of each split line and its lower envelope */
+        duration hull_building{0};
+        /**
+         * Dropping the points far outside of the cell from the children they're farther from than
+         * the points nearest to the children's centers everywhere (see
+         * splitting_condition::far_extent)
+         */
+        duration far_point_dropping{0};
+        /** Pushing every point to the children it reaches */
+        duration child_distribution{0};
+
+        auto total() const {
+            return octant_bitmasking + hull_building + far_point_dropping + child_distribution;
+        }
+
+        auto& operator+=(const split_timings& other) {
+            octant_bitmasking += other.octant_bitmasking;
+            hull_building += other.hull_building;
+            far_point_dropping += other.far_point_dropping;
+            child_distribution += other.child_distribution;
+            return *this;
+        }
+    };
+
+    struct depth_stats {
+        /** The number of cells at this depth */
+        size_t cells_processed{0};
+        size_t cells_split{0};
+        size_t leaves_emitted{0};
+        /** The number of points in the cells that were split */
+        size_t points_in_split_cells{0};
+        /** The number of points in the children of the split cells, counting copies of a point */
+        size_t points_pushed_to_children{0};
+
+        split_timings split_time{};
+        /** The time spent inserting the cells into the hash table */
+        duration hash_insert_time{0};
+        /** The elapsed time for the whole depth */
+        duration depth_time{0};
+
+        /**
+         * @return The average number of children a point of a split cell was pushed to, which is 1
+         * if no point reaches more than one child
+         */
+        auto duplication_factor() const {
+            return points_in_split_cells == 0 ? 1.0
+                                              : static_cast<double>(points_pushed_to_children) /
+                                                    static_cast<double>(points_in_split_cells);
+        }
+
+        auto& operator+=(const depth_stats& other) {
+            cells_processed += other.cells_processed;
+            cells_split += other.cells_split;
+            leaves_emitted += other.leaves_emitted;
+            points_in_split_cells += other.points_in_split_cells;
+            points_pushed_to_children += other.points_pushed_to_children;
+            split_time += other.split_time;
+            hash_insert_time += other.hash_insert_time;
+            depth_time += other.depth_time;
+            return *this;
+        }
+    };
+
+    /** The statistics of every depth, indexed by depth */
+    std::vector<depth_stats> depths{};
+    /** The elapsed time of the whole construction, including building the leaf storage */
+    duration total_time{0};
+
+    /** @return The statistics of all depths added together */
+    auto totals() const {
+        depth_stats result{};
+        for (const auto& depth : depths) {
+            result += depth;
+        }
+        return result;
+    }
+};
+
+/**
+ * Writes one line per depth, followed by the totals over all depths and the total construction
+ * time. Times are in microseconds
+ */
+inline auto operator<<(std::ostream& os, const build_stats& stats) -> std::ostream& {
+    auto microseconds = [](build_stats::duration time) {
+        return std::chrono::duration<double, std::micro>(time).count();
+    };
+    auto write = [&](const build_stats::depth_stats& depth) {
+        os << " cells=" << depth.cells_processed << " split=" << depth.cells_split
+           << " leaves=" << depth.leaves_emitted << " points=" << depth.points_in_split_cells
+           << " pushed=" << depth.points_pushed_to_children
+           << " duplication=" << depth.duplication_factor()
+           << " octant_us=" << microseconds(depth.split_time.octant_bitmasking)
+           << " hull_us=" << microseconds(depth.split_time.hull_building)
+           << " far_drop_us=" << microseconds(depth.split_time.far_point_dropping)
+           << " distribution_us=" << microseconds(depth.split_time.child_distribution)
+           << " hash_insert_us=" << microseconds(depth.hash_insert_time)
+           << " depth_us=" << microseconds(depth.depth_time) << '\n';
+    };
+    for (size_t depth = 0; depth < std::size(stats.depths); depth++) {
+        os << "depth " << depth;
+        write(stats.depths[depth]);
+    }
+    os << "total";
+    write(stats.totals());
+    os << "build_us=" << microseconds(stats.total_time) << '\n';
+    return os;
+}
+
+}  // namespace implicit_octree_nns
+
+#endif  // IMPLICIT_OCTREE_NNS_BUILD_STATS_HPP
@@ -1,8 +1,8 @@
 #ifndef IMPLICIT_OCTREE_NNS_AXIS_ALIGNED_HPP
 #define IMPLICIT_OCTREE_NNS_AXIS_ALIGNED_HPP
 
+#include <array>
 #include <stdexcept>
-#include <vector>
 
 #include "implicit_octree_nns/detail/equation.hpp"
 #include "implicit_octree_nns/point_traits.hpp"
@@ -23,16 +23,27 @@ class axis_aligned {
    public:
     axis_aligned(axes axis_, coordinate_type position_)
         : axis_aligned(index_of(axis_), position_) {}
+    /**
+     * Same as above, but the variables of the distance equations are the free coordinates relative
+     * to origin. Keeping origin close to the points keeps the terms of the equations on the scale
+     * of the distances between them rather than of the coordinates, which is what makes them
+     * precise enough to tell apart points in small cells, especially with float coordinates
+     */
+    axis_aligned(axes axis_, coordinate_type position_, const point_type& origin_)
+        : axis_aligned(index_of(axis_), position_) {
+        origin = origin_;
+    }
 
     /**
      * @return equation representing the distance function between the input point and the
      * axis-aligned line as a function of the free dimension(s) position
      *
      * The common quadratic term for each free dimension is left out of the equation since we merely
-     * care about the relative ordering of these equations
+     * care about the relative ordering of these equations, which doesn't depend on origin either
      */
     auto make_distance_equation(const point_type& point) -> equation<coordinate_type, dimension> {
-        std::vector<coordinate_type> slope;
+        std::array<coordinate_type, dimension - 1> slope{};
+        size_t num_slopes = 0;
         coordinate_type constant{0};
         for (size_t dim = 0; dim < dimension; dim++) {
             auto point_coordinate = point_traits<point_type>::get(point, dim);
@@ -40,7 +51,8 @@ class axis_aligned {
                 auto delta = (point_coordinate - position);
                 constant += delta * delta;
             } else {
-                slope.push_back(-2 * point_coordinate);
+                point_coordinate -= point_traits<point_type>::get(origin, dim);
+                slope[num_slopes++] = -2 * point_coordinate;
                 constant += point_coordinate * point_coordinate;
             }
         }
@@ -53,6 +65,7 @@ class axis_aligned {
 
     coordinate_type position;
     int fixed_dimension;
+    point_type origin{};
 
    private:
     axis_aligned(int fixed_dimension_, coordinate_type position_)
@@ -1,10 +1,13 @@
 #ifndef IMPLICIT_OCTREE_NNS_BOUNDING_BOX_HPP
 #define IMPLICIT_OCTREE_NNS_BOUNDING_BOX_HPP
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <iterator>
+#include <limits>
 
 #include "implicit_octree_nns/point_traits.hpp"
 
@@ -22,6 +25,57 @@ class bounding_box {
             minmax_per_dimension[i + 1] = magnitude;
         }
     }
+    /**
+     * @return The smallest box containing every point in [begin, end), with both ends of each side
+     * moved out by padding times the side's length. Sides are padded by at least min_padding, so
+     * that no point is on the upper boundary of the box, and a side of length 0 (eg. if every point
+     * has the same coordinate) gets the length of the longest side, or 1 if every side has length 0
+     *
+     * @pre [begin, end) isn't empty
+     */
+    template <typename ForwardIterator>
+    static auto fitted(ForwardIterator begin, ForwardIterator end, coordinate_type padding = 0) {
+        bounding_box box{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            box.min(dim) = std::numeric_limits<coordinate_type>::max();
+            box.max(dim) = std::numeric_limits<coordinate_type>::lowest();
+        }
+        for (; begin != end; ++begin) {
+            for (size_t dim = 0; dim < dimension; dim++) {
+                auto coordinate = point_traits<point_type>::get(*begin, dim);
+                box.min(dim) = std::min(box.min(dim), coordinate);
+                box.max(dim) = std::max(box.max(dim), coordinate);
+            }
+        }
+        coordinate_type longest{0};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            longest = std::max(longest, box.length(dim));
+        }
+        if (longest == 0) {
+            longest = 1;
+        }
+        for (size_t dim = 0; dim < dimension; dim++) {
+            if (box.length(dim) == 0) {
+                box.min(dim) -= longest / 2;
+                box.max(dim) = box.min(dim) + longest;
+            }
+            auto margin = box.length(dim) * std::max(padding, min_padding);
+            box.min(dim) -= margin;
+            box.max(dim) += margin;
+        }
+        return box;
+    }
+
+    /**
+     * The relative rounding error tolerated between coordinates of the same boundary that are
+     * computed differently, eg. by repeated halving or by stepping from the minimum corner
+     */
+    static constexpr auto rounding_tolerance =
+        16 * std::numeric_limits<coordinate_type>::epsilon();
+
+    /** The least fraction of its length that each side of a fitted box is padded by */
+    static constexpr auto min_padding = coordinate_type{1} / (1u << 20u);
+
     // [TODO]: Add unit tests for mid/length (tests for other functions are in test_octree_cell
     constexpr auto min(size_t dim) const { return minmax_per_dimension[2 * dim]; }
     constexpr auto& min(size_t dim) { return minmax_per_dimension[2 * dim]; }
@@ -33,10 +87,9 @@ class bounding_box {
     constexpr auto length(size_t dim) const { return max(dim) - min(dim); }
 
     constexpr auto all_lengths_same() const {
-        constexpr auto EPS = 1e-6;
         auto first = length(0);
         for (size_t dim = 0; dim < dimension; dim++) {
-            if (abs(length(dim) - first) > EPS) {
+            if (std::abs(length(dim) - first) > rounding_tolerance * std::abs(first)) {
                 return false;
             }
         }
@@ -57,14 +110,22 @@ class bounding_box {
 
     // [TODO]: Add unit tests for floored_corner
     constexpr auto floored_corner(const point_type& point, int depth) const {
-        constexpr auto EPS = 1e-10;
+        auto num_cells = static_cast<coordinate_type>(1LL << depth);
         point_type corner{};
         for (size_t dim = 0; dim < dimension; dim++) {
             auto point_coordinate = point_traits<point_type>::get(point, dim);
             auto step = step_at_depth(dim, depth);
             auto delta = point_coordinate - min(dim);
             auto num_steps = delta / step;
-            auto num_steps_floored = std::floor(num_steps + EPS);
+            // A point on a cell boundary (eg. the smallest corner of a cell, computed by halving
+            // the root box) can be rounded to slightly fewer steps than the boundary, by the
+            // rounding error of the coordinates in steps. The tolerance for it is capped so that
+            // it stays a small part of a cell at depths beyond the precision of coordinate_type
+            auto magnitude = std::abs(point_coordinate) + std::abs(min(dim));
+            auto tolerance =
+                std::min(rounding_tolerance * magnitude / step, coordinate_type{1} / 64);
+            // Like lattice keys, a point on the upper boundary belongs to the last cell
+            auto num_steps_floored = std::min(std::floor(num_steps + tolerance), num_cells - 1);
             point_traits<point_type>::set(corner, dim, num_steps_floored);
         }
         return corner;
@@ -97,7 +158,6 @@ class bounding_box {
                 children[bitmask].min(dim) = upper_half ? mid(dim) : min(dim);
                 children[bitmask].max(dim) = upper_half ? max(dim) : mid(dim);
             }
-            assert(children[bitmask].all_lengths_same());
         }
         return children;
     }
@@ -112,6 +172,36 @@ class bounding_box {
         return true;
     }
 
+    /** @return The squared distance from point to the closest position in the box */
+    constexpr auto distance_squared(const point_type& point) const {
+        coordinate_type result{0};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto point_coord = point_traits<point_type>::get(point, dim);
+            auto delta = std::max({min(dim) - point_coord, point_coord - max(dim),
+                                   coordinate_type{0}});
+            result += delta * delta;
+        }
+        return result;
+    }
+
+    /**
+     * @return Whether every position in the box is strictly closer to point than to other, ie.
+     * the box doesn't reach the Voronoi cell of other in any point set containing point
+     */
+    constexpr auto closer_everywhere(const point_type& point, const point_type& other) const {
+        // Per dimension, (q - other)^2 - (q - point)^2 = delta * (2q - point - other) is linear in
+        // q, so the smallest difference of squared distances is found at one of the box's corners
+        coordinate_type margin{0};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto point_coord = point_traits<point_type>::get(point, dim);
+            auto other_coord = point_traits<point_type>::get(other, dim);
+            auto delta = point_coord - other_coord;
+            auto position = delta > 0 ? min(dim) : max(dim);
+            margin += delta * (2 * position - point_coord - other_coord);
+        }
+        return margin > 0;
+    }
+
     /**
      * @return A bitmask representing the octant/quadtrant of the bounding_box that point lies in.
      * The i-th bit of the bitmask will be on if the point is in the upper half (or on the halfway
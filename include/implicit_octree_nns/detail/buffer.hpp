@@ -0,0 +1,93 @@
+#ifndef IMPLICIT_OCTREE_NNS_BUFFER_HPP
+#define IMPLICIT_OCTREE_NNS_BUFFER_HPP
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace implicit_octree_nns::detail {
+
+/**
+ * @brief A read-only array that either owns its elements or borrows them from memory owned
+ * elsewhere, eg. a memory-mapped index file
+ *
+ * Copies of an owning buffer own a copy of the elements, while copies of a borrowing buffer borrow
+ * the same elements; whoever created a borrowing buffer is responsible for keeping its memory alive
+ */
+template <typename T>
+class buffer {
+   public:
+    using value_type = T;
+
+    buffer() = default;
+    explicit buffer(std::vector<T> values)
+        : owned_{std::move(values)}, data_{owned_.data()}, size_{owned_.size()}, owns_{true} {}
+    buffer(const T* data, size_t size) : data_{data}, size_{size} {}
+
+    buffer(const buffer& other)
+        : owned_{other.owned_},
+          data_{other.owns_ ? owned_.data() : other.data_},
+          size_{other.size_},
+          owns_{other.owns_} {}
+    buffer(buffer&& other) noexcept
+        : owned_{std::move(other.owned_)},
+          data_{other.owns_ ? owned_.data() : other.data_},
+          size_{other.size_},
+          owns_{other.owns_} {
+        other = buffer{};
+    }
+    buffer& operator=(buffer other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(buffer& other) noexcept {
+        // Owned elements don't move when the vectors are swapped, so the data pointers stay valid
+        std::swap(owned_, other.owned_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(owns_, other.owns_);
+    }
+
+    auto data() const { return data_; }
+    auto size() const { return size_; }
+    auto empty() const { return size_ == 0; }
+    auto begin() const { return data_; }
+    auto end() const { return data_ + size_; }
+    const auto& operator[](size_t index) const { return data_[index]; }
+
+    /** Whether the buffer owns its elements, in which case they can be modified */
+    auto owns() const { return owns_; }
+
+    /**
+     * @return The owned elements, copying borrowed elements first so they can be modified
+     */
+    auto& mutable_elements() {
+        if (!owns_) {
+            *this = buffer{std::vector<T>(begin(), end())};
+        }
+        return owned_;
+    }
+
+    /**
+     * Updates the buffer after the vector returned by mutable_elements was modified
+     */
+    void elements_changed() {
+        assert(owns_);
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+
+    /** @return The number of bytes allocated for owned elements */
+    auto bytes_used() const { return owned_.capacity() * sizeof(T); }
+
+   private:
+    std::vector<T> owned_{};
+    const T* data_{nullptr};
+    size_t size_{0};
+    bool owns_{false};
+};
+
+}  // namespace implicit_octree_nns::detail
+
+#endif  // IMPLICIT_OCTREE_NNS_BUFFER_HPP
@@ -47,9 +47,18 @@ struct equation<coordinate_type, 3> {
         return slope1 * position1 + slope2 * position2 + constant;
     }
 
-    // [TODO]: Add implementation and documentation for 3d function intersection
-    auto intersection_with(const equation& other) const -> std::optional<coordinate_type> {
-        return std::nullopt;
+    /**
+     * @return nullopt if the planes are parallel (or equal), otherwise the line at which both
+     * planes evaluate to be the same value, given as the equation (this - other) whose zero set is
+     * that line; it is negative on the side of the line where this plane is lower
+     */
+    auto intersection_with(const equation& other) const -> std::optional<equation> {
+        if (slope1 == other.slope1 && slope2 == other.slope2) {
+            return std::nullopt;
+        } else {
+            return equation{slope1 - other.slope1, slope2 - other.slope2,
+                            constant - other.constant};
+        }
     }
 
     auto operator==(const equation& other) const {
@@ -2,12 +2,16 @@
 #define IMPLICIT_OCTREE_NNS_EQUATION_HULL_HPP
 
 #include <algorithm>
+#include <array>
 #include <cassert>
-#include <deque>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <numeric>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "implicit_octree_nns/detail/equation.hpp"
 
@@ -19,9 +23,27 @@ class equation_hull {
     static_assert(dimension == 2 || dimension == 3);
 };
 
+/**
+ * @brief A view of the contiguous tags of the equations on a lower envelope, which stays valid
+ * until the hull that returned it is rebuilt or asked for another envelope
+ */
+struct tag_range {
+    const int* first{nullptr};
+    const int* last{nullptr};
+
+    auto begin() const { return first; }
+    auto end() const { return last; }
+    auto size() const { return static_cast<size_t>(last - first); }
+    auto empty() const { return first == last; }
+};
+
 /**
  * Maintains or constructs the lower hull for a set of 2d equations. If equations are inserted
- * dynamically rather than provided offline, these equations must be sorted by decreasing slope
+ * dynamically rather than provided offline, these equations must be sorted by non-increasing slope,
+ * though equations with the same slope can be inserted in any order
+ *
+ * The hull is stored in vectors, so an instance that's rebuilt for every set of equations (eg. one
+ * per thread) only allocates when a set is larger than every set before it
  *
  * @pre All of the equations must be distinct (slope and constant cannot both be same)
  */
@@ -31,22 +53,54 @@ class equation_hull<coordinate_type, 2> {
 
    public:
     using equation_type = equation<coordinate_type, dimension>;
+
+    equation_hull() = default;
     template <typename RandomAccessIterator>
     equation_hull(RandomAccessIterator begin, RandomAccessIterator end) {
-        std::vector<int> indices(std::distance(begin, end));
-        std::iota(std::begin(indices), std::end(indices), 0);
-        std::sort(std::begin(indices), std::end(indices), [&begin](const auto& i, const auto& j) {
-            const auto a = *std::next(begin, i);
-            const auto b = *std::next(begin, j);
-            return std::tie(a.slope, a.constant) > std::tie(b.slope, b.constant);
+        build(begin, end);
+    }
+    /** Replaces the equations of the hull by those in [begin, end), reusing its storage */
+    template <typename RandomAccessIterator>
+    auto build(RandomAccessIterator begin, RandomAccessIterator end) {
+        clear();
+        order.resize(static_cast<size_t>(std::distance(begin, end)));
+        std::iota(std::begin(order), std::end(order), 0);
+        // Of several equal equations, the first one is kept
+        std::sort(std::begin(order), std::end(order), [&begin](int i, int j) {
+            const auto& a = begin[i];
+            const auto& b = begin[j];
+            return std::tie(a.slope, a.constant, j) > std::tie(b.slope, b.constant, i);
         });
-        std::for_each(std::begin(indices), std::end(indices),
-                      [&](int i) { push(*std::next(begin, i), i); });
+        for (auto i : order) {
+            push(begin[i], i);
+        }
+    }
+    /**
+     * Same as build, but the equations are inserted in the order of the positions (offsets from
+     * begin) in [order_begin, order_end), without sorting them, so building takes linear time
+     *
+     * @pre The positions list equations by non-increasing slope, and equal equations by
+     * increasing position for the same equations to be kept as by build
+     */
+    template <typename RandomAccessIterator, typename ForwardIterator>
+    auto build_sorted(RandomAccessIterator begin, ForwardIterator order_begin,
+                      ForwardIterator order_end) {
+        clear();
+        for (; order_begin != order_end; ++order_begin) {
+            auto i = static_cast<int>(*order_begin);
+            push(begin[i], i);
+        }
+    }
+    auto clear() {
+        hull.clear();
+        indices_on_hull.clear();
     }
     auto push(const equation_type& eq, int tag) {
         assert(std::empty(hull) || eq.slope <= min_slope);
         min_slope = eq.slope;
         if (!std::empty(hull) && eq.slope == hull.back().slope) {
+            // Of two parallel lines, only the lower one can be on the envelope
+            if (eq.constant >= hull.back().constant) return;
             hull.pop_back();
             indices_on_hull.pop_back();
         }
@@ -58,12 +112,13 @@ class equation_hull<coordinate_type, 2> {
         indices_on_hull.push_back(tag);
     }
     /**
-     * @return the indices of the equations that are on the lower envelope of all equations. If the
-     * constructor was used to create this object, the indices are 0-indexed offsets from the
-     * beginning of the input range (ie. the 'begin' parameter)
+     * @return the indices of the equations that are on the lower envelope of all equations, as a
+     * view into the hull. If the constructor or build was used to fill this object, the indices
+     * are 0-indexed offsets from the beginning of the input range (ie. the 'begin' parameter)
      */
     auto lower_envelope(coordinate_type lo = -std::numeric_limits<coordinate_type>::max(),
-                        coordinate_type hi = std::numeric_limits<coordinate_type>::max()) const {
+                        coordinate_type hi = std::numeric_limits<coordinate_type>::max()) const
+        -> tag_range {
         size_t begin = 0;
         size_t end = std::size(hull);
         while (end - begin >= 2) {
@@ -84,13 +139,13 @@ class equation_hull<coordinate_type, 2> {
                 break;
             }
         }
-        return std::deque(std::begin(indices_on_hull) + begin, std::begin(indices_on_hull) + end);
+        return {std::data(indices_on_hull) + begin, std::data(indices_on_hull) + end};
     }
 
    private:
     auto makes_back_redundant(const equation_type& eq) {
-        auto last = hull[std::size(hull) - 1];
-        auto second_last = hull[std::size(hull) - 2];
+        const auto& last = hull[std::size(hull) - 1];
+        const auto& second_last = hull[std::size(hull) - 2];
         auto intersection_eq_with_second_last = eq.intersection_with(second_last);
         auto intersection_current_last_two = last.intersection_with(second_last);
 
@@ -99,15 +154,25 @@ class equation_hull<coordinate_type, 2> {
         return *intersection_eq_with_second_last < *intersection_current_last_two;
     }
 
-    std::deque<equation_type> hull;
-    std::deque<int> indices_on_hull;
-    coordinate_type min_slope;
+    std::vector<equation_type> hull;
+    std::vector<int> indices_on_hull;
+    coordinate_type min_slope{};
+    /** The positions of the built equations by decreasing slope */
+    std::vector<int> order;
 };
 
 /**
- * Maintains or constructs the lower hull for a set of 3d equations.
+ * Finds the planes of a set of 3d equations that are on their lower envelope somewhere within an
+ * axis-aligned rectangle of positions
  *
- * @pre All of the equations must be distinct (slope and constant cannot both be same)
+ * The rectangle is recursively bisected, and only equations that can still be lowest somewhere in a
+ * sub-rectangle (they're below the equation that's lowest at its center somewhere in it) are kept
+ * for it. Once few enough equations are left, each of them is kept if the region of the
+ * sub-rectangle where it's the lowest, found by clipping the sub-rectangle with every other
+ * equation, isn't empty. Comparisons allow for rounding errors, so an equation that is lowest at
+ * exactly one position, or is close to being lowest, is always kept
+ *
+ * @pre All of the equations must be distinct (slopes and constant cannot all be same)
  */
 template <typename coordinate_type>
 class equation_hull<coordinate_type, 3> {
@@ -115,19 +180,201 @@ class equation_hull<coordinate_type, 3> {
 
    public:
     using equation_type = equation<coordinate_type, dimension>;
+
+    equation_hull() = default;
     template <typename RandomAccessIterator>
-    equation_hull(RandomAccessIterator begin, RandomAccessIterator end) {}
-    auto push(const equation_type& eq, int tag) {}
-    auto lower_envelope(coordinate_type lo = -std::numeric_limits<coordinate_type>::max(),
-                        coordinate_type hi = std::numeric_limits<coordinate_type>::max()) const {
-        return std::deque{0};
+    equation_hull(RandomAccessIterator begin, RandomAccessIterator end) {
+        build(begin, end);
+    }
+    /** Replaces the equations of the hull by those in [begin, end), reusing its storage */
+    template <typename RandomAccessIterator>
+    auto build(RandomAccessIterator begin, RandomAccessIterator end) {
+        clear();
+        auto num_equations = static_cast<int>(std::distance(begin, end));
+        for (int it = 0; it < num_equations; it++) {
+            push(begin[it], it);
+        }
+    }
+    auto clear() {
+        equations.clear();
+        tags.clear();
+    }
+    auto push(const equation_type& eq, int tag) {
+        equations.push_back(eq);
+        tags.push_back(tag);
+    }
+    /**
+     * @return the tags of the equations that are on the lower envelope of all equations somewhere
+     * within [lo1, hi1] x [lo2, hi2], as a view that the next call overwrites. If the constructor or
+     * build was used to fill this object, the tags are 0-indexed offsets from the beginning of the
+     * input range (ie. the 'begin' parameter)
+     */
+    auto lower_envelope(coordinate_type lo1, coordinate_type hi1, coordinate_type lo2,
+                        coordinate_type hi2) -> tag_range {
+        candidates_per_depth.resize(max_bisection_depth + 1);
+        auto& candidates = candidates_per_depth.front();
+        candidates.resize(std::size(equations));
+        std::iota(std::begin(candidates), std::end(candidates), 0);
+        envelope_flags.assign(std::size(equations), 0);
+        collect({lo1, hi1, lo2, hi2}, candidates, 0);
+
+        envelope_tags.clear();
+        for (size_t it = 0; it < std::size(equations); it++) {
+            if (envelope_flags[it]) {
+                envelope_tags.push_back(tags[it]);
+            }
+        }
+        return {std::data(envelope_tags), std::data(envelope_tags) + std::size(envelope_tags)};
+    }
+
+   private:
+    /** Sub-rectangles with at most this many candidates are clipped instead of bisected */
+    static constexpr size_t max_clipped_candidates = 8;
+    /** Bounds the bisection when many equations are (almost) lowest at the same position */
+    static constexpr int max_bisection_depth = 48;
+    /** Relative tolerance for comparing the values of equations */
+    static constexpr auto tolerance = 64 * std::numeric_limits<coordinate_type>::epsilon();
+
+    struct rectangle {
+        coordinate_type lo1, hi1, lo2, hi2;
+    };
+    using vertex = std::pair<coordinate_type, coordinate_type>;
+
+    /**
+     * Flags the candidates that are on the envelope within rect. The candidates of the first half
+     * of a bisected rect are copied to the buffer of the next depth, so the buffers of every depth
+     * are reused by every call, and the second half prunes the candidates of rect in place
+     */
+    auto collect(const rectangle& rect, std::vector<int>& candidates, int depth) -> void {
+        prune(rect, candidates);
+        auto all_found = std::all_of(std::begin(candidates), std::end(candidates),
+                                     [&](int it) { return envelope_flags[it]; });
+        if (all_found) {
+            return;
+        }
+        if (std::size(candidates) <= max_clipped_candidates || depth == max_bisection_depth) {
+            for (auto it : candidates) {
+                if (!envelope_flags[it] && is_lowest_somewhere(it, candidates, rect)) {
+                    envelope_flags[it] = true;
+                }
+            }
+            return;
+        }
+        // Bisect the longer side of the rectangle
+        auto first = rect;
+        auto second = rect;
+        if (rect.hi1 - rect.lo1 >= rect.hi2 - rect.lo2) {
+            first.hi1 = second.lo1 = rect.lo1 / 2 + rect.hi1 / 2;
+        } else {
+            first.hi2 = second.lo2 = rect.lo2 / 2 + rect.hi2 / 2;
+        }
+        auto& first_candidates = candidates_per_depth[depth + 1];
+        first_candidates.assign(std::begin(candidates), std::end(candidates));
+        collect(first, first_candidates, depth + 1);
+        collect(second, candidates, depth + 1);
+    }
+
+    /**
+     * Removes the candidates that are higher than the candidate that's lowest at the center of rect
+     * everywhere within rect. Comparing every candidate to the same plane rather than to its own
+     * bounds keeps this tight when the planes are almost parallel, and since both planes are
+     * linear, their difference is lowest at a corner of rect
+     */
+    auto prune(const rectangle& rect, std::vector<int>& candidates) const {
+        const std::array<vertex, 4> corners{vertex{rect.lo1, rect.lo2}, vertex{rect.hi1, rect.lo2},
+                                            vertex{rect.hi1, rect.hi2}, vertex{rect.lo1, rect.hi2}};
+        auto center1 = rect.lo1 / 2 + rect.hi1 / 2;
+        auto center2 = rect.lo2 / 2 + rect.hi2 / 2;
+        auto lowest = *std::min_element(
+            std::begin(candidates), std::end(candidates), [&](int i, int j) {
+                return equations[i].evaluate_at(center1, center2) <
+                       equations[j].evaluate_at(center1, center2);
+            });
+        const auto& reference = equations[lowest];
+        size_t kept = 0;
+        for (auto index : candidates) {
+            const auto& eq = equations[index];
+            auto difference = equation_type{eq.slope1 - reference.slope1,
+                                            eq.slope2 - reference.slope2,
+                                            eq.constant - reference.constant};
+            auto below_somewhere = std::any_of(
+                std::begin(corners), std::end(corners), [&](const vertex& position) {
+                    const auto& [position1, position2] = position;
+                    auto slack = tolerance * (magnitude(eq, position1, position2) +
+                                              magnitude(reference, position1, position2));
+                    return difference.evaluate_at(position1, position2) <= slack;
+                });
+            if (below_somewhere) {
+                candidates[kept++] = index;
+            }
+        }
+        candidates.resize(kept);
     }
-    // [TODO]: This needs to either be handled better since 3d has more than just [lo, hi] (it will
-    // need two lo's and two hi's), or prove that these extra extraneous intersections "at infinity"
-    // don't increase # of cells drastically
-};
 
-// [TODO]: Add implementation for equation hull<coordinate_type, 3> specialization
+    /**
+     * @return Whether the region of rect where equation index is lower than every other candidate
+     * isn't empty, found by clipping rect with the half-plane where index is lower than each
+     */
+    auto is_lowest_somewhere(int index, const std::vector<int>& candidates,
+                             const rectangle& rect) {
+        auto& region = clip_region;
+        auto& clipped = clipped_region;
+        region.assign({{rect.lo1, rect.lo2}, {rect.hi1, rect.lo2}, {rect.hi1, rect.hi2},
+                       {rect.lo1, rect.hi2}});
+        const auto& eq = equations[index];
+        for (auto other_index : candidates) {
+            if (other_index == index) continue;
+            const auto& other = equations[other_index];
+            // Parallel planes differ by the same amount everywhere
+            auto difference = eq.intersection_with(other).value_or(
+                equation_type{0, 0, eq.constant - other.constant});
+            auto excess = [&](const vertex& position) {
+                auto slack = tolerance * (magnitude(eq, position.first, position.second) +
+                                          magnitude(other, position.first, position.second));
+                return difference.evaluate_at(position.first, position.second) - slack;
+            };
+            // Sutherland-Hodgman clipping of the convex region by difference <= slack
+            clipped.clear();
+            for (size_t it = 0; it < std::size(region); it++) {
+                const auto& from = region[it];
+                const auto& to = region[(it + 1) % std::size(region)];
+                auto from_excess = excess(from);
+                auto to_excess = excess(to);
+                if (from_excess <= 0) {
+                    clipped.push_back(from);
+                }
+                if ((from_excess <= 0) != (to_excess <= 0)) {
+                    auto t = from_excess / (from_excess - to_excess);
+                    clipped.push_back({from.first + t * (to.first - from.first),
+                                       from.second + t * (to.second - from.second)});
+                }
+            }
+            std::swap(region, clipped);
+            if (std::empty(region)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** An upper bound on the magnitude of the terms of eq at a position, to scale tolerances */
+    static auto magnitude(const equation_type& eq, coordinate_type position1,
+                          coordinate_type position2) {
+        using std::abs;
+        return abs(eq.slope1 * position1) + abs(eq.slope2 * position2) + abs(eq.constant);
+    }
+
+    std::vector<equation_type> equations;
+    std::vector<int> tags;
+    /** Buffers of lower_envelope, kept between calls */
+    std::vector<uint8_t> envelope_flags;
+    std::vector<int> envelope_tags;
+    /** The candidates of the sub-rectangles at each depth of the bisection */
+    std::vector<std::vector<int>> candidates_per_depth;
+    /** The region clipped by is_lowest_somewhere, and the result of clipping it once more */
+    std::vector<vertex> clip_region;
+    std::vector<vertex> clipped_region;
+};
 
 }  // namespace implicit_octree_nns::detail
 
@@ -10,7 +10,10 @@
 
 #include "implicit_octree_nns/detail/kd_tree.hpp"
 #include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
 #include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/query_executor.hpp"
 
 namespace implicit_octree_nns::detail {
 using namespace std::string_literals;
@@ -84,6 +87,7 @@ void log_size_data(const std::string& logname, const distribution_type& distribu
                                                 max_coord, std::cout, splitter};
     ofile << "num_cells: " << locator.size() << '\n';
     ofile << "max_depth: " << locator.depth() << '\n';
+    ofile << locator.build_statistics();
 }
 
 template <typename distribution_type>
@@ -116,9 +120,11 @@ void visualization_data(const std::string& logname, distribution_type distributi
     }
 }
 
-template <typename distribution_type>
+template <template <typename> typename hash_table_model = model::hash_table,
+          typename distribution_type>
 void benchmark_data(const std::string& logname, distribution_type distribution, int num_points,
-                    int num_queries, int max_points, unsigned generator_seed) {
+                    int num_queries, int max_points, unsigned generator_seed,
+                    const std::string& hash_table_label = "") {
     constexpr auto dimension = experiment_dimension;
     using coordinate_type = experiment_coord_type;
 
@@ -135,8 +141,8 @@ void benchmark_data(const std::string& logname, distribution_type distribution,
         std::uniform_real_distribution<coordinate_type>(-max_coord, max_coord));
 
     auto start_time_build = std::chrono::high_resolution_clock::now();
-    auto locator = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
-                                                max_coord, std::cout, splitter};
+    auto locator = nearest_neighbor<point_type, hash_table_model<point_type>>{
+        std::begin(point_set), std::end(point_set), max_coord, std::cout, splitter};
     auto end_time_build = std::chrono::high_resolution_clock::now();
     auto time_build_ms =
         std::chrono::duration_cast<experiment_time_scale>((end_time_build - start_time_build))
@@ -154,12 +160,56 @@ void benchmark_data(const std::string& logname, distribution_type distribution,
 
     const std::string build_prefix{"benchmark.construct."};
     const std::string query_prefix{"benchmark.query."};
+    const std::string memory_prefix{"benchmark.memory."};
     std::string name = makename(logname, dimension, num_points, num_queries,
-                                static_cast<int>(max_coord), max_points, generator_seed);
+                                static_cast<int>(max_coord),
+                                hash_table_label + std::to_string(max_points), generator_seed);
     std::ofstream build_file(build_prefix + name + ".log");
     std::ofstream query_file(query_prefix + name + ".log");
+    std::ofstream memory_file(memory_prefix + name + ".log");
     build_file << time_build_ms << '\n';
     query_file << time_ms << '\n';
+    memory_file << locator.octree_hash_table().bytes_used() << '\n';
+    memory_file << locator.leaf_bytes_used() << '\n';
+}
+
+template <typename distribution_type>
+void parallel_query_data(const std::string& logname, distribution_type distribution,
+                         int num_points, int num_queries, int max_points, unsigned num_threads,
+                         unsigned generator_seed) {
+    constexpr auto dimension = experiment_dimension;
+    using coordinate_type = experiment_coord_type;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, distribution);
+    auto max_coord = get_max_magnitude(std::begin(point_set), std::end(point_set));
+
+    using point_type = std::remove_reference_t<decltype(*std::begin(point_set))>;
+    auto splitter = splitting_condition{};
+    splitter.max_points = max_points;
+
+    auto queries = generate_random_points<dimension>(
+        num_queries, generator,
+        std::uniform_real_distribution<coordinate_type>(-max_coord, max_coord));
+    auto results = std::vector<point_type>(std::size(queries));
+
+    auto locator = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                                max_coord, std::cout, splitter};
+    auto executor = query_executor{locator, num_threads};
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    executor.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(results));
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration<double>(end_time - start_time).count();
+
+    const std::string query_prefix{"benchmark.parallel_query."};
+    std::string name = makename(logname, dimension, num_points, num_queries,
+                                static_cast<int>(max_coord),
+                                std::to_string(max_points) + "threads" +
+                                    std::to_string(executor.num_threads()),
+                                generator_seed);
+    std::ofstream query_file(query_prefix + name + ".log");
+    query_file << static_cast<long long>(static_cast<double>(num_queries) / elapsed) << '\n';
 }
 
 template <typename distribution_type>
@@ -233,17 +283,39 @@ auto visualize_generator(
     return visualize;
 }
 
-template <typename distribution_type, typename bound_type>
+template <template <typename> typename hash_table_model = model::hash_table,
+          typename distribution_type, typename bound_type>
 auto benchmark_generator(
     std::tuple<distribution_type, bound_type, std::string> distribution_bounds_name,
-    unsigned seed_ = 5) {
+    const std::string& hash_table_label_ = "", unsigned seed_ = 5) {
     auto [distribution_, bounds_, name_] = distribution_bounds_name;
-    auto benchmark = [distribution = distribution_, name = name_, seed = seed_](
-                         int num_points, int num_queries, int max_points) {
+    auto benchmark = [distribution = distribution_, name = name_, seed = seed_,
+                      hash_table_label = hash_table_label_](int num_points, int num_queries,
+                                                            int max_points) {
         std::cout << "Running benchmark " << name << " with " << num_points << " points "
                   << num_queries << " queries"
-                  << " with M = " << max_points << " and seed " << seed << std::endl;
-        benchmark_data(name, distribution, num_points, num_queries, max_points, seed);
+                  << " with M = " << max_points << " and seed " << seed << " on the "
+                  << (hash_table_label.empty() ? "default" : hash_table_label) << " hash table"
+                  << std::endl;
+        benchmark_data<hash_table_model>(name, distribution, num_points, num_queries, max_points,
+                                         seed, hash_table_label);
+    };
+    return benchmark;
+}
+
+template <typename distribution_type, typename bound_type>
+auto parallel_query_generator(
+    std::tuple<distribution_type, bound_type, std::string> distribution_bounds_name,
+    unsigned seed_ = 5) {
+    auto [distribution_, bounds_, name_] = distribution_bounds_name;
+    auto benchmark = [distribution = distribution_, name = name_, seed = seed_](
+                         int num_points, int num_queries, int max_points, unsigned num_threads) {
+        std::cout << "Running parallel query benchmark " << name << " with " << num_points
+                  << " points " << num_queries << " queries"
+                  << " with M = " << max_points << " on " << num_threads << " threads"
+                  << " and seed " << seed << std::endl;
+        parallel_query_data(name, distribution, num_points, num_queries, max_points, num_threads,
+                            seed);
     };
     return benchmark;
 }
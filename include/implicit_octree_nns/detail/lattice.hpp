@@ -0,0 +1,117 @@
+#ifndef IMPLICIT_OCTREE_NNS_LATTICE_HPP
+#define IMPLICIT_OCTREE_NNS_LATTICE_HPP
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include "implicit_octree_nns/detail/bounding_box.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+namespace implicit_octree_nns::detail {
+
+/**
+ * @brief Integer lattice over a root bounding box, used to name octree cells by packed 64-bit keys
+ *
+ * A point is converted once into fixed-point lattice coordinates with max_depth bits per dimension;
+ * the coordinates of the cell containing it at depth d are then the top d bits of each coordinate.
+ * The key of a cell is the Morton code (bit interleaving) of its coordinates, tagged with a leading
+ * 1 bit placed right above them so that the same coordinates at different depths have different
+ * keys. Because the cell coordinates at every depth are prefixes of the same fixed-point
+ * coordinates, the cells probed for a point always form a single root-to-leaf chain
+ */
+template <typename point_type>
+class lattice {
+   public:
+    using coordinate_type = typename point_traits<point_type>::coordinate_type;
+    static constexpr auto dimension = point_traits<point_type>::dimension;
+    using coordinates_type = std::array<std::uint64_t, dimension>;
+    /**
+     * The type that the lattice coordinates are computed in. The lattice resolves more bits than
+     * float holds, so float coordinates are converted to double first; the boxes of the cells are
+     * then only off by their own rounding, rather than by that of the steps too
+     */
+    using scalar_type = std::common_type_t<coordinate_type, double>;
+
+    /** The deepest depth whose cells can be keyed, limited by the 64 bits available per key */
+    static constexpr int max_depth = (64 - 1) / dimension;
+
+    lattice() = default;
+    explicit lattice(const bounding_box<point_type>& root_box) {
+        constexpr auto cells_per_dimension = static_cast<scalar_type>(1ULL << max_depth);
+        for (size_t dim = 0; dim < dimension; dim++) {
+            origin_[dim] = root_box.min(dim);
+            scale_[dim] = cells_per_dimension / (static_cast<scalar_type>(root_box.max(dim)) -
+                                                 static_cast<scalar_type>(root_box.min(dim)));
+        }
+    }
+
+    /**
+     * @return The coordinates of the deepest lattice cell containing point. Points outside of the
+     * root box are clamped to its boundary cells
+     */
+    auto fixed_point(const point_type& point) const {
+        constexpr auto max_coordinate = (1ULL << max_depth) - 1;
+        coordinates_type coordinates{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto coordinate = static_cast<scalar_type>(point_traits<point_type>::get(point, dim));
+            auto steps = (coordinate - origin_[dim]) * scale_[dim];
+            if (!(steps > 0)) {
+                coordinates[dim] = 0;
+            } else if (steps >= static_cast<scalar_type>(max_coordinate)) {
+                coordinates[dim] = max_coordinate;
+            } else {
+                coordinates[dim] = static_cast<std::uint64_t>(steps);
+            }
+        }
+        return coordinates;
+    }
+
+    /**
+     * @return The key of the cell at the given depth that contains the deepest lattice cell with
+     * the given coordinates
+     * @pre 0 <= depth <= max_depth
+     */
+    static auto key(const coordinates_type& coordinates, int depth) {
+        auto shift = static_cast<unsigned>(max_depth - depth);
+        std::uint64_t interleaved = 0;
+        for (size_t dim = 0; dim < dimension; dim++) {
+            interleaved |= spread_bits(coordinates[dim] >> shift) << dim;
+        }
+        auto depth_tag = std::uint64_t{1} << (static_cast<unsigned>(depth) * dimension);
+        return depth_tag | interleaved;
+    }
+
+    auto key(const point_type& point, int depth) const { return key(fixed_point(point), depth); }
+
+   private:
+    /**
+     * @return bits with dimension - 1 zeroes inserted after each of its (max_depth) low bits
+     */
+    static auto spread_bits(std::uint64_t bits) {
+        if constexpr (dimension == 2) {
+            bits &= 0x00000000ffffffffULL;
+            bits = (bits | (bits << 16u)) & 0x0000ffff0000ffffULL;
+            bits = (bits | (bits << 8u)) & 0x00ff00ff00ff00ffULL;
+            bits = (bits | (bits << 4u)) & 0x0f0f0f0f0f0f0f0fULL;
+            bits = (bits | (bits << 2u)) & 0x3333333333333333ULL;
+            bits = (bits | (bits << 1u)) & 0x5555555555555555ULL;
+        } else {
+            bits &= 0x00000000001fffffULL;
+            bits = (bits | (bits << 32u)) & 0x001f00000000ffffULL;
+            bits = (bits | (bits << 16u)) & 0x001f0000ff0000ffULL;
+            bits = (bits | (bits << 8u)) & 0x100f00f00f00f00fULL;
+            bits = (bits | (bits << 4u)) & 0x10c30c30c30c30c3ULL;
+            bits = (bits | (bits << 2u)) & 0x1249249249249249ULL;
+        }
+        return bits;
+    }
+
+    std::array<scalar_type, dimension> origin_{};
+    std::array<scalar_type, dimension> scale_{};
+};
+
+}  // namespace implicit_octree_nns::detail
+
+#endif  // IMPLICIT_OCTREE_NNS_LATTICE_HPP
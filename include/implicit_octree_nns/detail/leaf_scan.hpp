@@ -0,0 +1,322 @@
+#ifndef IMPLICIT_OCTREE_NNS_LEAF_SCAN_HPP
+#define IMPLICIT_OCTREE_NNS_LEAF_SCAN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && \
+    !defined(IMPLICIT_OCTREE_NNS_DISABLE_SIMD)
+#define IMPLICIT_OCTREE_NNS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace implicit_octree_nns::detail {
+
+/**
+ * The instruction sets a leaf scan can use, ordered from least to most capable
+ */
+enum class simd_level { scalar, sse2, avx2, avx512 };
+
+/**
+ * @return The most capable instruction set supported by both the build and the running processor
+ */
+inline auto detected_simd_level() {
+    static const auto level = [] {
+#ifdef IMPLICIT_OCTREE_NNS_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return simd_level::avx512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            return simd_level::avx2;
+        } else {
+            return simd_level::sse2;
+        }
+#else
+        return simd_level::scalar;
+#endif
+    }();
+    return level;
+}
+
+/**
+ * @brief The closest point found by a leaf scan, as an index into the scanned block
+ */
+template <typename coordinate_type>
+struct scan_result {
+    size_t index{0};
+    coordinate_type distance_squared{std::numeric_limits<coordinate_type>::max()};
+};
+
+/**
+ * Continues a scan over the points [first, count) of a block with scalar code, keeping the first
+ * closest point on ties
+ *
+ * A block of count points stores its coordinates dimension by dimension (structure of arrays): the
+ * coordinate dim of point i is at coordinates[dim * count + i]
+ */
+template <typename coordinate_type, size_t dimension>
+auto scan_closest_scalar(const coordinate_type* coordinates, size_t count,
+                         const std::array<coordinate_type, dimension>& query, size_t first = 0,
+                         scan_result<coordinate_type> result = {}) {
+    for (auto it = first; it < count; it++) {
+        coordinate_type distance = 0;
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto delta = coordinates[dim * count + it] - query[dim];
+            distance += delta * delta;
+        }
+        if (distance < result.distance_squared) {
+            result = {it, distance};
+        }
+    }
+    return result;
+}
+
+#ifdef IMPLICIT_OCTREE_NNS_X86_SIMD
+
+/**
+ * @return The smallest of the given lanes, reduced pairwise to keep the chain of dependent
+ * comparisons short
+ * @pre width is a power of two
+ */
+template <typename coordinate_type, size_t width>
+auto min_lane(std::array<coordinate_type, width> lanes) {
+    for (auto half = width / 2; half > 0; half /= 2) {
+        for (size_t lane = 0; lane < half; lane++) {
+            lanes[lane] = std::min(lanes[lane], lanes[lane + half]);
+        }
+    }
+    return lanes[0];
+}
+
+/*
+ * Each instruction set gets its own copy of the scan, compiled for that instruction set only, so
+ * the kernels can live in one binary and be picked at runtime. The kernel is written once below and
+ * expanded in the namespace of each instruction set, next to the operations on its vectors: a
+ * function's target comes from where it is defined, so a single template would be compiled for the
+ * default target whatever its vector operations are. Contracting multiplies and adds into
+ * fused multiply-adds (implied by AVX-512) is disabled, since it rounds distances differently from
+ * the scalar scan
+ *
+ * Tracking the index of the running minimum in every lane costs about as much as computing the
+ * distances, and merging the lanes takes a chain of unpredictable comparisons. Instead, a kernel
+ * first finds the smallest distance alone, with two independent running minimums so consecutive
+ * vectors don't wait on each other. It then recomputes distances from the start of the block until
+ * one matches it, which on average stops halfway through
+ */
+
+#define IMPLICIT_OCTREE_NNS_SCAN_CLOSEST_KERNEL                                                    \
+template <typename coordinate_type, size_t dimension>                                              \
+auto scan_closest(const coordinate_type* coordinates, size_t count,                                \
+                  const std::array<coordinate_type, dimension>& query) {                           \
+    using ops = std::conditional_t<std::is_same_v<coordinate_type, float>, ops_float, ops_double>; \
+    constexpr auto width = ops::width;                                                             \
+    constexpr auto max_distance = std::numeric_limits<coordinate_type>::max();                     \
+    typename ops::vector query_lanes[dimension];                                                   \
+    for (size_t dim = 0; dim < dimension; dim++) {                                                 \
+        query_lanes[dim] = ops::set1(query[dim]);                                                  \
+    }                                                                                              \
+    auto distances_at = [&](size_t first) {                                                        \
+        auto distance = ops::set1(0);                                                              \
+        for (size_t dim = 0; dim < dimension; dim++) {                                             \
+            auto delta = ops::sub(ops::load(coordinates + dim * count + first), query_lanes[dim]); \
+            distance = ops::add(distance, ops::mul(delta, delta));                                 \
+        }                                                                                          \
+        return distance;                                                                           \
+    };                                                                                             \
+                                                                                                   \
+    auto vector_end = count - count % width;                                                       \
+    auto closest = ops::set1(max_distance), other_closest = ops::set1(max_distance);               \
+    size_t it = 0;                                                                                 \
+    for (; it + 2 * width <= vector_end; it += 2 * width) {                                        \
+        closest = ops::min(distances_at(it), closest);                                             \
+        other_closest = ops::min(distances_at(it + width), other_closest);                         \
+    }                                                                                              \
+    if (it < vector_end) {                                                                         \
+        closest = ops::min(distances_at(it), closest);                                             \
+    }                                                                                              \
+    std::array<coordinate_type, width> lanes{};                                                    \
+    ops::store(lanes.data(), ops::min(closest, other_closest));                                    \
+    auto result = scan_closest_scalar(coordinates, count, query, vector_end,                       \
+                                      {count, min_lane(lanes)});                                   \
+    if (result.index < count || !(result.distance_squared < max_distance)) {                       \
+        return result.index < count ? result : scan_result<coordinate_type>{};                     \
+    }                                                                                              \
+    auto target = ops::set1(result.distance_squared);                                              \
+    for (it = 0;; it += width) {                                                                   \
+        if (auto mask = ops::equal_mask(distances_at(it), target)) {                               \
+            result.index = it + static_cast<size_t>(__builtin_ctz(mask));                          \
+            return result;                                                                         \
+        }                                                                                          \
+    }                                                                                              \
+}
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")
+namespace sse2 {
+
+struct ops_double {
+    using vector = __m128d;
+    static constexpr size_t width = 2;
+    static auto set1(double value) { return _mm_set1_pd(value); }
+    static auto load(const double* values) { return _mm_loadu_pd(values); }
+    static auto store(double* values, vector lanes) { _mm_storeu_pd(values, lanes); }
+    static auto add(vector a, vector b) { return _mm_add_pd(a, b); }
+    static auto sub(vector a, vector b) { return _mm_sub_pd(a, b); }
+    static auto mul(vector a, vector b) { return _mm_mul_pd(a, b); }
+    static auto min(vector a, vector b) { return _mm_min_pd(a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpeq_pd(a, b)));
+    }
+};
+
+struct ops_float {
+    using vector = __m128;
+    static constexpr size_t width = 4;
+    static auto set1(float value) { return _mm_set1_ps(value); }
+    static auto load(const float* values) { return _mm_loadu_ps(values); }
+    static auto store(float* values, vector lanes) { _mm_storeu_ps(values, lanes); }
+    static auto add(vector a, vector b) { return _mm_add_ps(a, b); }
+    static auto sub(vector a, vector b) { return _mm_sub_ps(a, b); }
+    static auto mul(vector a, vector b) { return _mm_mul_ps(a, b); }
+    static auto min(vector a, vector b) { return _mm_min_ps(a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(a, b)));
+    }
+};
+
+IMPLICIT_OCTREE_NNS_SCAN_CLOSEST_KERNEL
+
+}  // namespace sse2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+namespace avx2 {
+
+struct ops_double {
+    using vector = __m256d;
+    static constexpr size_t width = 4;
+    static auto set1(double value) { return _mm256_set1_pd(value); }
+    static auto load(const double* values) { return _mm256_loadu_pd(values); }
+    static auto store(double* values, vector lanes) { _mm256_storeu_pd(values, lanes); }
+    static auto add(vector a, vector b) { return _mm256_add_pd(a, b); }
+    static auto sub(vector a, vector b) { return _mm256_sub_pd(a, b); }
+    static auto mul(vector a, vector b) { return _mm256_mul_pd(a, b); }
+    static auto min(vector a, vector b) { return _mm256_min_pd(a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)));
+    }
+};
+
+struct ops_float {
+    using vector = __m256;
+    static constexpr size_t width = 8;
+    static auto set1(float value) { return _mm256_set1_ps(value); }
+    static auto load(const float* values) { return _mm256_loadu_ps(values); }
+    static auto store(float* values, vector lanes) { _mm256_storeu_ps(values, lanes); }
+    static auto add(vector a, vector b) { return _mm256_add_ps(a, b); }
+    static auto sub(vector a, vector b) { return _mm256_sub_ps(a, b); }
+    static auto mul(vector a, vector b) { return _mm256_mul_ps(a, b); }
+    static auto min(vector a, vector b) { return _mm256_min_ps(a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)));
+    }
+};
+
+IMPLICIT_OCTREE_NNS_SCAN_CLOSEST_KERNEL
+
+}  // namespace avx2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+namespace avx512 {
+
+struct ops_double {
+    using vector = __m512d;
+    static constexpr size_t width = 8;
+    static constexpr __mmask8 all_lanes = 0xff;
+    static auto set1(double value) { return _mm512_set1_pd(value); }
+    static auto load(const double* values) { return _mm512_loadu_pd(values); }
+    static auto store(double* values, vector lanes) { _mm512_storeu_pd(values, lanes); }
+    static auto add(vector a, vector b) { return _mm512_add_pd(a, b); }
+    static auto sub(vector a, vector b) { return _mm512_sub_pd(a, b); }
+    static auto mul(vector a, vector b) { return _mm512_mul_pd(a, b); }
+    static auto min(vector a, vector b) { return _mm512_maskz_min_pd(all_lanes, a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ));
+    }
+};
+
+struct ops_float {
+    using vector = __m512;
+    static constexpr size_t width = 16;
+    static constexpr __mmask16 all_lanes = 0xffff;
+    static auto set1(float value) { return _mm512_set1_ps(value); }
+    static auto load(const float* values) { return _mm512_loadu_ps(values); }
+    static auto store(float* values, vector lanes) { _mm512_storeu_ps(values, lanes); }
+    static auto add(vector a, vector b) { return _mm512_add_ps(a, b); }
+    static auto sub(vector a, vector b) { return _mm512_sub_ps(a, b); }
+    static auto mul(vector a, vector b) { return _mm512_mul_ps(a, b); }
+    static auto min(vector a, vector b) { return _mm512_maskz_min_ps(all_lanes, a, b); }
+    static auto equal_mask(vector a, vector b) {
+        return static_cast<unsigned>(_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ));
+    }
+};
+
+IMPLICIT_OCTREE_NNS_SCAN_CLOSEST_KERNEL
+
+}  // namespace avx512
+#pragma GCC pop_options
+
+#undef IMPLICIT_OCTREE_NNS_SCAN_CLOSEST_KERNEL
+
+#endif  // IMPLICIT_OCTREE_NNS_X86_SIMD
+
+/**
+ * Finds the point of a structure of arrays block (see scan_closest_scalar) closest to query with
+ * the given instruction set, which must be supported by the processor
+ *
+ * Every kernel computes each squared distance with the same sequence of floating-point operations
+ * as the scalar code and breaks ties towards the smaller index, so all of them return the same
+ * result
+ */
+template <typename coordinate_type, size_t dimension>
+auto scan_closest(simd_level level, const coordinate_type* coordinates, size_t count,
+                  const std::array<coordinate_type, dimension>& query) {
+#ifdef IMPLICIT_OCTREE_NNS_X86_SIMD
+    if constexpr (std::is_same_v<coordinate_type, float> ||
+                  std::is_same_v<coordinate_type, double>) {
+        switch (level) {
+            case simd_level::avx512:
+                return avx512::scan_closest(coordinates, count, query);
+            case simd_level::avx2:
+                return avx2::scan_closest(coordinates, count, query);
+            case simd_level::sse2:
+                return sse2::scan_closest(coordinates, count, query);
+            case simd_level::scalar:
+                break;
+        }
+    }
+#endif
+    return scan_closest_scalar(coordinates, count, query);
+}
+
+/**
+ * Same as above, with the most capable instruction set of the running processor
+ */
+template <typename coordinate_type, size_t dimension>
+auto scan_closest(const coordinate_type* coordinates, size_t count,
+                  const std::array<coordinate_type, dimension>& query) {
+    return scan_closest(detected_simd_level(), coordinates, count, query);
+}
+
+}  // namespace implicit_octree_nns::detail
+
+#endif  // IMPLICIT_OCTREE_NNS_LEAF_SCAN_HPP
@@ -0,0 +1,309 @@
+#ifndef IMPLICIT_OCTREE_NNS_LEAF_STORAGE_HPP
+#define IMPLICIT_OCTREE_NNS_LEAF_STORAGE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "implicit_octree_nns/detail/buffer.hpp"
+#include "implicit_octree_nns/detail/leaf_scan.hpp"
+#include "implicit_octree_nns/detail/octree_cell.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+namespace implicit_octree_nns::detail {
+
+/**
+ * @brief The points of every octree leaf, stored back to back in a single array
+ *
+ * The points of leaf i are at [ranges[i].begin, ranges[i].end) of the index array, which replaces
+ * one heap allocation per leaf with a few allocations in total and keeps the final scan of a query
+ * within one contiguous block of memory. Leaves only store the indices of their points into the
+ * point set shared by all leaves, so a point reaching several leaves is stored once
+ *
+ * Next to the indices, the coordinates of every leaf are also stored as a structure of arrays block
+ * (see scan_closest_scalar) starting at dimension * ranges[i].begin, which lets the final scan
+ * compute several distances per instruction
+ *
+ * The leaves are stored in order when the storage is built. A leaf that is changed afterwards (see
+ * assign_leaf) is rewritten at the end of the arrays, leaving its previous points unused until the
+ * arrays are compacted once they hold as many unused points as used ones
+ *
+ * Erased points stay in the point set, so the indices of the other points don't change, and are
+ * marked by a tombstone instead (see erase_point)
+ *
+ * Every array is a buffer, so the storage can also borrow the arrays of a saved index (eg. from a
+ * memory-mapped file), kept alive by the storage itself
+ */
+template <typename point_type>
+class leaf_storage {
+   public:
+    using coordinate_type = typename point_traits<point_type>::coordinate_type;
+    static constexpr auto dimension = point_traits<point_type>::dimension;
+    using offset_type = std::uint32_t;
+    using index_type = typename octree_cell<point_type>::index_type;
+    using point_set_type = typename octree_cell<point_type>::point_set_type;
+
+    /** The position of the points of a leaf in the index array */
+    struct leaf_range {
+        offset_type begin;
+        offset_type end;
+    };
+
+    leaf_storage() = default;
+
+    /**
+     * Moves the indices of every leaf into the storage, leaving the leaves without points
+     * @pre All leaves were split from the same root cell
+     */
+    explicit leaf_storage(std::vector<octree_cell<point_type>>& leaves) {
+        size_t num_points = 0;
+        for (const auto& leaf : leaves) {
+            assert(leaf.point_set == leaves.front().point_set);
+            num_points += leaf.size();
+        }
+        if (num_points > std::numeric_limits<offset_type>::max()) {
+            throw std::length_error("Too many points stored in octree leaves");
+        }
+        if (!std::empty(leaves)) {
+            const auto& point_set = leaves.front().point_set;
+            points_ = buffer<point_type>{point_set->data(), point_set->size()};
+            keep_alive_ = point_set;
+            borrows_points_ = true;
+        }
+        std::vector<leaf_range> ranges;
+        std::vector<index_type> indices;
+        std::vector<coordinate_type> coordinates;
+        ranges.reserve(std::size(leaves));
+        indices.reserve(num_points);
+        coordinates.reserve(num_points * dimension);
+        for (auto& leaf : leaves) {
+            for (size_t dim = 0; dim < dimension; dim++) {
+                for (size_t it = 0; it < leaf.size(); it++) {
+                    coordinates.push_back(point_traits<point_type>::get(leaf.point(it), dim));
+                }
+            }
+            auto begin = static_cast<offset_type>(std::size(indices));
+            indices.insert(std::end(indices), std::begin(leaf.indices), std::end(leaf.indices));
+            ranges.push_back({begin, static_cast<offset_type>(std::size(indices))});
+            std::vector<index_type>{}.swap(leaf.indices);
+        }
+        ranges_ = buffer<leaf_range>{std::move(ranges)};
+        indices_ = buffer<index_type>{std::move(indices)};
+        coordinates_ = buffer<coordinate_type>{std::move(coordinates)};
+    }
+
+    /**
+     * Wraps previously stored arrays (see point_array etc.) without copying them
+     * @param keep_alive Owns the memory of any borrowing buffer, and is kept alive with the storage
+     * @pre The arrays were taken from a leaf_storage
+     */
+    leaf_storage(buffer<point_type> points, buffer<leaf_range> ranges, buffer<index_type> indices,
+                 buffer<coordinate_type> coordinates, buffer<std::uint8_t> erased,
+                 std::shared_ptr<const void> keep_alive)
+        : keep_alive_{std::move(keep_alive)},
+          points_{std::move(points)},
+          ranges_{std::move(ranges)},
+          indices_{std::move(indices)},
+          coordinates_{std::move(coordinates)},
+          erased_{std::move(erased)} {
+        // The arrays may have been saved before unused points were compacted away
+        unused_ = std::size(indices_);
+        for (size_t leaf = 0; leaf < num_leaves(); leaf++) {
+            unused_ -= size(leaf);
+        }
+        num_erased_ = static_cast<size_t>(std::count(std::begin(erased_), std::end(erased_), 1));
+    }
+
+    /** The number of leaves */
+    auto num_leaves() const { return std::size(ranges_); }
+
+    /** The number of points in all leaves, counting points stored in several leaves repeatedly */
+    auto size() const { return std::size(indices_) - unused_; }
+
+    /** The number of points in the given leaf */
+    auto size(size_t leaf) const {
+        return static_cast<size_t>(ranges_[leaf].end - ranges_[leaf].begin);
+    }
+
+    /** The range of point indices of the given leaf */
+    auto begin(size_t leaf) const { return std::begin(indices_) + ranges_[leaf].begin; }
+    auto end(size_t leaf) const { return std::begin(indices_) + ranges_[leaf].end; }
+
+    /** The number of points in the shared point set, including erased points */
+    auto num_points() const { return std::size(points_); }
+
+    /** The number of points in the shared point set that haven't been erased */
+    auto num_live_points() const { return num_points() - num_erased_; }
+
+    /** Whether the point with the given index was erased (see erase_point) */
+    auto erased(index_type index) const { return !std::empty(erased_) && erased_[index] != 0; }
+
+    /** @return The point with the given index in the shared point set */
+    const auto& point(index_type index) const { return points_[index]; }
+
+    /**
+     * @returns The index of the point of the given leaf that is closest to query_point, and its
+     * squared distance to query_point
+     * @pre The leaf isn't empty
+     */
+    auto closest(size_t leaf, const point_type& query_point) const {
+        assert(size(leaf) > 0);
+        std::array<coordinate_type, dimension> query{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            query[dim] = point_traits<point_type>::get(query_point, dim);
+        }
+        auto closest = scan_closest(coordinates(leaf), size(leaf), query);
+        closest.index = indices_[ranges_[leaf].begin + closest.index];
+        return closest;
+    }
+
+    /**
+     * @returns The point of the given leaf that is closest to query_point
+     * @pre The leaf isn't empty
+     */
+    auto closest_point(size_t leaf, const point_type& query_point) const -> point_type {
+        return point(static_cast<index_type>(closest(leaf, query_point).index));
+    }
+
+    /** @return The structure of arrays coordinate block of the given leaf */
+    auto coordinates(size_t leaf) const {
+        return coordinates_.data() + dimension * ranges_[leaf].begin;
+    }
+
+    /**
+     * Appends point to the shared point set. The first point added copies the point set, which
+     * stops it from being shared with the octree cells
+     *
+     * @return The index of point in the point set
+     */
+    auto add_point(const point_type& point) -> index_type {
+        if (num_points() >= std::numeric_limits<index_type>::max()) {
+            throw std::length_error("Too many points to be indexed by octree cells");
+        }
+        points_.mutable_elements().push_back(point);
+        points_.elements_changed();
+        if (!std::empty(erased_)) {
+            erased_.mutable_elements().push_back(0);
+            erased_.elements_changed();
+        }
+        if (borrows_points_) {
+            // The storage now owns a copy of the points, so keep_alive_ no longer has to keep the
+            // borrowed point set alive
+            keep_alive_.reset();
+            borrows_points_ = false;
+        }
+        return static_cast<index_type>(num_points() - 1);
+    }
+
+    /**
+     * Marks the point with the given index as erased. The point stays in the point set, and the
+     * caller is responsible for removing it from the leaves that hold it
+     */
+    auto erase_point(index_type index) {
+        assert(index < num_points() && !erased(index));
+        auto& erased = erased_.mutable_elements();
+        erased.resize(num_points(), 0);
+        erased[index] = 1;
+        erased_.elements_changed();
+        num_erased_++;
+    }
+
+    /**
+     * Replaces the points of leaf with the given indices into the point set, or adds a new leaf
+     * if leaf is num_leaves()
+     */
+    auto assign_leaf(size_t leaf, const std::vector<index_type>& leaf_indices) {
+        assert(leaf <= num_leaves());
+        auto begin = std::size(indices_);
+        if (begin + std::size(leaf_indices) > std::numeric_limits<offset_type>::max()) {
+            throw std::length_error("Too many points stored in octree leaves");
+        }
+        auto& ranges = ranges_.mutable_elements();
+        auto& indices = indices_.mutable_elements();
+        auto& coordinates = coordinates_.mutable_elements();
+        if (leaf == num_leaves()) {
+            ranges.push_back({0, 0});
+        } else {
+            unused_ += size(leaf);
+        }
+        indices.insert(std::end(indices), std::begin(leaf_indices), std::end(leaf_indices));
+        for (size_t dim = 0; dim < dimension; dim++) {
+            for (auto index : leaf_indices) {
+                coordinates.push_back(point_traits<point_type>::get(point(index), dim));
+            }
+        }
+        ranges[leaf] = {static_cast<offset_type>(begin),
+                        static_cast<offset_type>(std::size(indices))};
+        ranges_.elements_changed();
+        indices_.elements_changed();
+        coordinates_.elements_changed();
+        if (unused_ > size()) {
+            compact();
+        }
+    }
+
+    /** The underlying arrays, eg. for saving the storage */
+    const auto& point_array() const { return points_; }
+    const auto& range_array() const { return ranges_; }
+    const auto& index_array() const { return indices_; }
+    const auto& coordinate_array() const { return coordinates_; }
+    /** One tombstone per point, or empty if no point was ever erased */
+    const auto& erased_array() const { return erased_; }
+
+    /**
+     * @return The number of bytes allocated for the leaf ranges, the indices, the coordinates, the
+     * tombstones and the shared point set; arrays borrowed from a saved index aren't counted
+     */
+    auto bytes_used() const {
+        auto point_set_bytes =
+            borrows_points_ ? std::size(points_) * sizeof(point_type) : points_.bytes_used();
+        return ranges_.bytes_used() + indices_.bytes_used() + coordinates_.bytes_used() +
+               erased_.bytes_used() + point_set_bytes;
+    }
+
+   private:
+    /** Rewrites the points of every leaf back to back in leaf order, dropping unused points */
+    auto compact() {
+        std::vector<index_type> indices;
+        std::vector<coordinate_type> coordinates;
+        indices.reserve(size());
+        coordinates.reserve(size() * dimension);
+        auto& ranges = ranges_.mutable_elements();
+        for (auto& range : ranges) {
+            auto begin = static_cast<offset_type>(std::size(indices));
+            indices.insert(std::end(indices), std::begin(indices_) + range.begin,
+                           std::begin(indices_) + range.end);
+            auto leaf_coordinates = coordinates_.data() + dimension * range.begin;
+            auto leaf_size = static_cast<size_t>(range.end - range.begin);
+            coordinates.insert(std::end(coordinates), leaf_coordinates,
+                               leaf_coordinates + dimension * leaf_size);
+            range = {begin, static_cast<offset_type>(std::size(indices))};
+        }
+        ranges_.elements_changed();
+        indices_ = buffer<index_type>{std::move(indices)};
+        coordinates_ = buffer<coordinate_type>{std::move(coordinates)};
+        unused_ = 0;
+    }
+
+    /** Owns the points, or every array if they're borrowed from a saved index */
+    std::shared_ptr<const void> keep_alive_{};
+    /** Whether points_ borrows the point set shared with the octree cells */
+    bool borrows_points_{false};
+    buffer<point_type> points_{};
+    buffer<leaf_range> ranges_{};
+    buffer<index_type> indices_{};
+    buffer<coordinate_type> coordinates_{};
+    buffer<std::uint8_t> erased_{};
+    size_t num_erased_{0};
+    /** The number of elements of the index array that no leaf uses since leaves were reassigned */
+    size_t unused_{0};
+};
+
+}  // namespace implicit_octree_nns::detail
+
+#endif  // IMPLICIT_OCTREE_NNS_LEAF_STORAGE_HPP
@@ -1,10 +1,22 @@
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <exception>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
 #include <utility>
 
 #include "implicit_octree_nns/detail/cgal_voronoi.hpp"
+#include "implicit_octree_nns/detail/parallel.hpp"
 #include "implicit_octree_nns/detail/utility.hpp"
 #include "implicit_octree_nns/visualize/drawing.hpp"
 
@@ -16,18 +28,49 @@ nearest_neighbor<point_type, hash_type>::nearest_neighbor(ForwardIterator begin,
                                                           ForwardIterator end,
                                                           coordinate_type max_coord,
                                                           std::ostream& visualize_ostream,
-                                                          splitting_condition condition)
-    : max_depth_used_{0}, drawer_{visualize_ostream, dimension}, condition_{condition} {
+                                                          splitting_condition condition,
+                                                          unsigned num_threads,
+                                                          root_box_policy box_policy)
+    : max_depth_used_{0},
+      num_threads_{detail::resolve_num_threads(num_threads)},
+      drawer_{visualize_ostream, dimension},
+      condition_{condition} {
+    if constexpr (uses_lattice_keys) {
+        condition_.max_depth = std::min(condition_.max_depth, lattice_type::max_depth);
+    }
+    using clock = std::chrono::steady_clock;
+    auto build_start = clock::now();
     construction_set_size_ = std::distance(begin, end);
-    initialize_bounding_box(begin, end, max_coord);
+    initialize_bounding_box(begin, end, max_coord, box_policy);
+    auto max_copies = condition_.max_copies_per_point > 0
+                          ? static_cast<size_t>(condition_.max_copies_per_point) *
+                                std::max<size_t>(construction_set_size_, 1)
+                          : std::numeric_limits<size_t>::max();
+    auto copies_in_leaves = size_t{0};
+    auto copies_in_cells = construction_set_size_;
     for (int depth = 0; !octree_cells_.empty(); depth++) {
+        auto depth_start = clock::now();
         if constexpr (do_visualize) {
             drawer_.draw_voronoi_edges(
                 detail::voronoi_segments<coordinate_type>::generate(begin, end, max_coord));
         }
-        split_saturated_cells(depth);
+        auto& stats = build_stats_.depths.emplace_back(split_saturated_cells(depth));
+        stats.depth_time =
+            std::chrono::duration_cast<build_stats::duration>(clock::now() - depth_start);
         max_depth_used_ = depth;
+        copies_in_leaves += copies_in_cells - stats.points_in_split_cells;
+        copies_in_cells = stats.points_pushed_to_children;
+        if (copies_in_leaves + copies_in_cells > max_copies) {
+            throw std::length_error(
+                "Splitting copied the points into too many cells; raise max_points or "
+                "max_copies_per_point of the splitting condition");
+        }
     }
+    leaf_points_ = leaf_storage_type{octree_leaves_};
+    // The leaf storage holds everything queries need, so the leaf cells aren't kept next to it
+    std::vector<octree_cell_type>{}.swap(octree_leaves_);
+    build_stats_.total_time =
+        std::chrono::duration_cast<build_stats::duration>(clock::now() - build_start);
 }
 
 template <typename point_type, typename hash_type>
@@ -37,7 +80,7 @@ auto nearest_neighbor<point_type, hash_type>::construction_set_size() const {
 
 template <typename point_type, typename hash_type>
 auto nearest_neighbor<point_type, hash_type>::size() const {
-    return std::size(octree_leaves_);
+    return leaf_points_.num_leaves() - std::size(free_leaves_);
 }
 
 template <typename point_type, typename hash_type>
@@ -48,65 +91,376 @@ auto nearest_neighbor<point_type, hash_type>::depth() const {
 template <typename point_type, typename hash_type>
 auto nearest_neighbor<point_type, hash_type>::find_nearest_neighbor(
     const point_type& query_point) const {
-    using detail::bsearch_result;
+    return point(find_nearest_neighbor_index(query_point));
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_nearest_neighbor_index(
+    const point_type& query_point) const -> index_type {
+    return find_nearest_neighbor_with_distance(query_point).index;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_nearest_neighbor_with_distance(
+    const point_type& query_point) const -> neighbor {
+    auto closest = leaf_points_.closest(checked_locate_leaf(query_point), query_point);
+    return {static_cast<index_type>(closest.index), closest.distance_squared};
+}
 
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_leaf_index(const point_type& query_point,
+                                                              size_t* num_probes) const -> int {
+    if (!root_cell_.box.contains(query_point)) return -1;
+    int leaf_depth = 0;
+    size_t probes = 0;
+    auto leaf = locate_leaf_from(key_source(query_point), -1, leaf_depth, probes);
+    if (num_probes != nullptr) *num_probes += probes;
+    return leaf;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_nearest_in_leaf(int leaf,
+                                                                   const point_type& query_point)
+    const -> neighbor {
+    auto closest = leaf_points_.closest(static_cast<size_t>(leaf), query_point);
+    return {static_cast<index_type>(closest.index), closest.distance_squared};
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::try_find_nearest_neighbor(
+    const point_type& query_point, out_of_box_query mode) const noexcept
+    -> std::optional<neighbor> {
+    if (root_cell_.box.contains(query_point)) {
+        auto closest = leaf_points_.closest(locate_contained_leaf(query_point), query_point);
+        return neighbor{static_cast<index_type>(closest.index), closest.distance_squared};
+    }
+    if (mode == out_of_box_query::reject) {
+        return std::nullopt;
+    }
+    // The closest position in the root box is on its boundary, and its leaf is the closest leaf
+    point_type clamped{};
+    for (size_t dim = 0; dim < dimension; dim++) {
+        auto coordinate = point_traits<point_type>::get(query_point, dim);
+        auto clamped_coordinate =
+            std::clamp(coordinate, root_cell_.box.min(dim), root_cell_.box.max(dim));
+        point_traits<point_type>::set(clamped, dim, clamped_coordinate);
+    }
+    int leaf_depth = 0;
+    locate_contained_leaf(clamped, &leaf_depth);
+    // The search allocates its queue, whose failure to grow is reported like a rejected query
+    try {
+        return find_k_nearest_from(query_point, clamped, leaf_depth, 1).front();
+    } catch (...) {
+        return std::nullopt;
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::checked_locate_leaf(const point_type& query_point,
+                                                                  int* leaf_depth) const -> int {
     if (!root_cell_.box.contains(query_point)) {
         throw std::invalid_argument("Query point outside bounding box of construction point set");
     }
-    int lo_depth = 0;
-    int hi_depth = max_depth_used_ + 1;
+    return locate_contained_leaf(query_point, leaf_depth);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::locate_contained_leaf(const point_type& query_point,
+                                                                    int* leaf_depth) const -> int {
     int leaf = -1;
-    while (lo_depth <= hi_depth) {
-        auto depth = (lo_depth + hi_depth) / 2;
-        auto corner = root_cell_.box.floored_corner(query_point, depth);
-        auto corner_depth = std::pair{corner, depth};
-        auto hash_entry = hash_table_traits<hash_type>::at(implicit_octree_, corner_depth);
-        bsearch_result result;
-        if (hash_entry == std::nullopt) {
-            result = bsearch_result::too_deep;
-        } else if (int leaf_index = *hash_entry; leaf_index == -1) {
-            result = bsearch_result::too_shallow;
-        } else {
-            leaf = leaf_index;
-            result = bsearch_result::just_right;
-        }
-        switch (result) {
-            case bsearch_result::too_deep:
-                hi_depth = depth - 1;
-                break;
-            case bsearch_result::too_shallow:
-                lo_depth = depth + 1;
-                break;
-            case bsearch_result::just_right:
-                lo_depth = 1;
-                hi_depth = -1;
-                break;
-            default:
-                assert(false);
-        }
+    if constexpr (do_visualize) {
+        drawer_.draw_atomically([&](const visualize::geometry_drawer& query_drawer) {
+            leaf = locate_leaf(query_point, query_drawer, leaf_depth);
+        });
+    } else {
+        leaf = locate_leaf(query_point, drawer_, leaf_depth);
+    }
+    return leaf;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::locate_leaf(const point_type& query_point,
+                                                          const visualize::geometry_drawer& drawer,
+                                                          int* leaf_depth) const -> int {
+    auto search = detail::depth_search{max_depth_used_ + 1};
+    auto source = key_source(query_point);
+    while (!search.done()) {
+        auto depth = search.depth();
+        auto key = make_key(source, depth);
+        auto result = search.update(cell_entry(key, depth));
         if constexpr (do_visualize) {
             auto query_box = root_cell_.box.floored_box(query_point, depth);
-            drawer_.draw_query(query_point, depth, result, query_box);
-            drawer_.write_end_query();
+            drawer.draw_query(query_point, depth, result, query_box);
+            drawer.write_end_query();
+        }
+    }
+    assert(search.leaf != -1);
+    if (leaf_depth != nullptr) {
+        *leaf_depth = search.leaf_depth;
+    }
+    return search.leaf;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::locate_leaf_from(const key_source_type& source,
+                                                               int hint_depth, int& leaf_depth,
+                                                               size_t& num_probes) const -> int {
+    auto search = detail::depth_search{max_depth_used_ + 1};
+    auto probe = [&](int depth) {
+        num_probes++;
+        auto key = make_key(source, depth);
+        return search.update(depth, cell_entry(key, depth));
+    };
+    if (search.lo_depth <= hint_depth && hint_depth <= search.hi_depth) {
+        auto result = probe(hint_depth);
+        if (!search.done()) {
+            probe(result == detail::bsearch_result::too_shallow ? search.lo_depth
+                                                                : search.hi_depth);
+        }
+    }
+    while (!search.done()) {
+        probe(search.depth());
+    }
+    assert(search.leaf != -1);
+    leaf_depth = search.leaf_depth;
+    return search.leaf;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_k_nearest(const point_type& query_point,
+                                                             size_t k) const
+    -> std::vector<neighbor> {
+    int leaf_depth = 0;
+    checked_locate_leaf(query_point, &leaf_depth);
+    return find_k_nearest_from(query_point, query_point, leaf_depth, k);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_k_nearest_from(const point_type& query_point,
+                                                                  const point_type& start,
+                                                                  int start_depth, size_t k) const
+    -> std::vector<neighbor> {
+    using box_type = detail::bounding_box<point_type>;
+    // A max-heap of the k closest points found so far
+    std::vector<neighbor> nearest;
+    auto closer = [](const neighbor& a, const neighbor& b) {
+        return a.distance_squared < b.distance_squared;
+    };
+    auto kth_distance = [&]() {
+        return std::size(nearest) < k ? std::numeric_limits<coordinate_type>::max()
+                                      : nearest.front().distance_squared;
+    };
+
+    // Leaves are queued with their index, internal cells with -1
+    struct queued_cell {
+        coordinate_type distance_squared;
+        int depth;
+        int leaf;
+        box_type box;
+    };
+    auto farther = [](const queued_cell& a, const queued_cell& b) {
+        return a.distance_squared > b.distance_squared;
+    };
+    std::priority_queue<queued_cell, std::vector<queued_cell>, decltype(farther)> cells(farther);
+    std::unordered_set<int> visited_leaves;
+    // Queues the cell of the given box, or the shallower leaf covering it if the cell doesn't exist
+    auto queue_cell = [&](const box_type& box, int depth) {
+        point_type center{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            point_traits<point_type>::set(center, dim, box.mid(dim));
+        }
+        auto source = key_source(center);
+        for (; depth >= 0; depth--) {
+            auto hash_entry = cell_entry(make_key(source, depth), depth);
+            if (!hash_entry) continue;
+            if (*hash_entry == -1 || visited_leaves.count(*hash_entry) == 0) {
+                auto cell_box = root_cell_.box.floored_box(center, depth);
+                cells.push({cell_box.distance_squared(query_point), depth, *hash_entry, cell_box});
+            }
+            return;
+        }
+    };
+    if (k > 0) {
+        queue_cell(root_cell_.box.floored_box(start, start_depth), start_depth);
+    }
+
+    while (!std::empty(cells) && cells.top().distance_squared <= kth_distance()) {
+        auto cell = cells.top();
+        cells.pop();
+        if (cell.leaf == -1) {
+            for (const auto& child_box : cell.box.sub_boxes()) {
+                queue_cell(child_box, cell.depth + 1);
+            }
+            continue;
+        }
+        if (!visited_leaves.insert(cell.leaf).second) continue;
+        for (auto it = leaf_points_.begin(cell.leaf); it != leaf_points_.end(cell.leaf); ++it) {
+            if (leaf_points_.erased(*it)) continue;
+            auto distance = point_traits<point_type>::distance_squared(point(*it), query_point);
+            if (distance >= kth_distance()) continue;
+            // Points reaching several leaves are seen once per leaf
+            auto index = static_cast<index_type>(*it);
+            auto seen = std::any_of(std::begin(nearest), std::end(nearest),
+                                    [&](const neighbor& found) { return found.index == index; });
+            if (seen) continue;
+            if (std::size(nearest) == k) {
+                std::pop_heap(std::begin(nearest), std::end(nearest), closer);
+                nearest.pop_back();
+            }
+            nearest.push_back({index, distance});
+            std::push_heap(std::begin(nearest), std::end(nearest), closer);
+        }
+        // Queue the cells of the same depth around the leaf, ie. every offset in {-1, 0, 1}^dimension
+        // other than the leaf itself
+        constexpr auto num_offsets = dimension == 2 ? 9 : 27;
+        for (int offset = 0; offset < num_offsets; offset++) {
+            auto neighbor_box = cell.box;
+            auto inside_root = true;
+            auto remaining = offset;
+            for (size_t dim = 0; dim < dimension; dim++, remaining /= 3) {
+                auto shift = static_cast<coordinate_type>(remaining % 3 - 1) * cell.box.length(dim);
+                neighbor_box.min(dim) += shift;
+                neighbor_box.max(dim) += shift;
+                auto mid = neighbor_box.mid(dim);
+                inside_root &= root_cell_.box.min(dim) < mid && mid < root_cell_.box.max(dim);
+            }
+            if (offset != num_offsets / 2 && inside_root) {
+                queue_cell(neighbor_box, cell.depth);
+            }
+        }
+    }
+    std::sort_heap(std::begin(nearest), std::end(nearest), closer);
+    return nearest;
+}
+
+template <typename point_type, typename hash_type>
+template <typename ForwardIterator, typename OutputIterator>
+auto nearest_neighbor<point_type, hash_type>::find_nearest_neighbors(ForwardIterator begin,
+                                                                     ForwardIterator end,
+                                                                     OutputIterator out) const {
+    locate_leaves(begin, end, [&](const point_type& query_point, int leaf) {
+        *out = leaf_points_.closest_point(leaf, query_point);
+        ++out;
+    });
+    return out;
+}
+
+template <typename point_type, typename hash_type>
+template <typename ForwardIterator, typename OutputIterator>
+auto nearest_neighbor<point_type, hash_type>::find_nearest_neighbor_indices(
+    ForwardIterator begin, ForwardIterator end, OutputIterator out) const {
+    locate_leaves(begin, end, [&](const point_type& query_point, int leaf) {
+        *out = static_cast<index_type>(leaf_points_.closest(leaf, query_point).index);
+        ++out;
+    });
+    return out;
+}
+
+template <typename point_type, typename hash_type>
+template <typename ForwardIterator, typename Callback>
+auto nearest_neighbor<point_type, hash_type>::locate_leaves(ForwardIterator begin,
+                                                            ForwardIterator end,
+                                                            Callback callback) const {
+    if constexpr (do_visualize) {
+        // Keep the per-query frames of the visualization output contiguous
+        for (; begin != end; ++begin) {
+            callback(*begin, checked_locate_leaf(*begin));
+        }
+    } else {
+        std::array<point_type, batch_block_size> queries;
+        std::array<key_source_type, batch_block_size> sources;
+        std::array<detail::depth_search, batch_block_size> searches;
+        std::array<std::optional<hash_table_value_type>, batch_block_size> hash_entries;
+        while (begin != end) {
+            size_t block_size = 0;
+            for (; block_size < batch_block_size && begin != end; block_size++, ++begin) {
+                queries[block_size] = *begin;
+                if (!root_cell_.box.contains(queries[block_size])) {
+                    throw std::invalid_argument(
+                        "Query point outside bounding box of construction point set");
+                }
+                sources[block_size] = key_source(queries[block_size]);
+                searches[block_size] = detail::depth_search{max_depth_used_ + 1};
+            }
+            // Every round probes one depth for each unfinished query; the probes of a round don't
+            // depend on each other, so their cache misses overlap instead of forming one chain
+            for (bool searching = true; searching;) {
+                searching = false;
+                for (size_t it = 0; it < block_size; it++) {
+                    if (searches[it].done()) continue;
+                    auto depth = searches[it].depth();
+                    hash_entries[it] = cell_entry(make_key(sources[it], depth), depth);
+                }
+                for (size_t it = 0; it < block_size; it++) {
+                    if (searches[it].done()) continue;
+                    searches[it].update(hash_entries[it]);
+                    searching |= !searches[it].done();
+                }
+            }
+            for (size_t it = 0; it < block_size; it++) {
+                assert(searches[it].leaf != -1);
+                callback(queries[it], searches[it].leaf);
+            }
         }
     }
-    assert(leaf != -1);
-    const auto& cell = octree_leaves_[leaf];
-    assert(cell.box.contains(query_point));
-    return cell.closest_point(query_point);
 }
 
 template <typename point_type, typename hash_type>
 template <typename ForwardIterator>
 auto nearest_neighbor<point_type, hash_type>::initialize_bounding_box(ForwardIterator begin,
                                                                       ForwardIterator end,
-                                                                      coordinate_type max_coord) {
-    root_cell_ = octree_cells_.emplace_back(begin, end, max_coord);
+                                                                      coordinate_type max_coord,
+                                                                      root_box_policy box_policy) {
+    const auto& root =
+        box_policy.fit_to_points
+            ? octree_cells_.emplace_back(
+                  begin, end,
+                  detail::bounding_box<point_type>::fitted(
+                      begin, end, static_cast<coordinate_type>(box_policy.padding)))
+            : octree_cells_.emplace_back(begin, end, max_coord);
+    // Only the box is needed after construction, the points stay referenced by the leaves
+    root_cell_.box = root.box;
+    lattice_ = lattice_type{root_cell_.box};
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::key_source(const point_type& point) const
+    -> key_source_type {
+    if constexpr (uses_lattice_keys) {
+        return lattice_.fixed_point(point);
+    } else {
+        return point;
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::make_key(const key_source_type& source,
+                                                       int depth) const -> hash_table_key_type {
+    if constexpr (uses_lattice_keys) {
+        return lattice_type::key(source, depth);
+    } else {
+        return std::pair{root_cell_.box.floored_corner(source, depth), depth};
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::cell_key(const octree_cell_type& cell,
+                                                       int depth) const -> hash_table_key_type {
+    if constexpr (uses_lattice_keys) {
+        // The center of a cell is the point furthest from rounding into a neighboring cell
+        point_type center{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            point_traits<point_type>::set(center, dim, cell.box.mid(dim));
+        }
+        return make_key(key_source(center), depth);
+    } else {
+        return make_key(cell.box.smallest_corner(), depth);
+    }
 }
 
 template <typename point_type, typename hash_type>
 auto nearest_neighbor<point_type, hash_type>::should_split(
-    const detail::octree_cell<point_type>& cell, const splitting_condition& condition) {
+    const detail::octree_cell<point_type>& cell, const splitting_condition& condition) const {
     // Make sure that the cell isn't too deep or too small to split further
     if (cell.depth() >= condition.max_depth) return false;
     for (int dim = 0; dim < dimension; dim++) {
@@ -119,7 +473,16 @@ auto nearest_neighbor<point_type, hash_type>::should_split(
 }
 
 template <typename point_type, typename hash_type>
-auto nearest_neighbor<point_type, hash_type>::split_saturated_cells(int depth) {
+auto nearest_neighbor<point_type, hash_type>::separates_points(
+    const detail::octree_cell<point_type>& cell,
+    const std::array<detail::octree_cell<point_type>, (1u << dimension)>& children) -> bool {
+    return std::any_of(std::begin(children), std::end(children),
+                       [&](const auto& child) { return child.size() < cell.size(); });
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::split_saturated_cells(int depth)
+    -> build_stats::depth_stats {
     std::vector<octree_cell_type> split_cells;
 
     if constexpr (do_visualize) {
@@ -131,23 +494,619 @@ auto nearest_neighbor<point_type, hash_type>::split_saturated_cells(int depth) {
         }
         drawer_.write_end_frame();
     }
-    for (const auto& cell : octree_cells_) {
-        auto bottom_left = cell.box.smallest_corner();
-        auto corner_depth = std::pair{root_cell_.box.floored_corner(bottom_left, depth), depth};
-        bool is_leaf = !should_split(cell, condition_);
-        int leaf_index = is_leaf ? static_cast<int>(std::size(octree_leaves_)) : -1;
-        hash_table_traits<hash_type>::insert(implicit_octree_, corner_depth, leaf_index);
-
-        // breakpoint
-        if (!is_leaf) {
-            auto child_cells = cell.split_into_children();
-            std::move(std::begin(child_cells), std::end(child_cells),
-                      std::back_inserter(split_cells));
+    auto num_cells = std::size(octree_cells_);
+    std::vector<hash_table_key_type> keys(num_cells);
+    std::vector<uint8_t> is_leaf(num_cells);
+    std::vector<std::vector<octree_cell_type>> children_per_chunk(num_threads_);
+    std::vector<build_stats::split_timings> split_time_per_chunk(num_threads_);
+    // The splits of a chunk reuse the same buffers for their temporaries
+    std::vector<detail::split_scratch<point_type>> scratch_per_chunk(num_threads_);
+    auto num_chunks = detail::parallel_for_chunks(
+        num_cells, num_threads_, [&](size_t chunk, size_t chunk_begin, size_t chunk_end) {
+            auto& children = children_per_chunk[chunk];
+            for (auto it = chunk_begin; it < chunk_end; it++) {
+                const auto& cell = octree_cells_[it];
+                keys[it] = cell_key(cell, depth);
+                is_leaf[it] = !should_split(cell, condition_);
+                if (!is_leaf[it]) {
+                    auto child_cells = cell.split_into_children(&split_time_per_chunk[chunk],
+                                                                &scratch_per_chunk[chunk],
+                                                                condition_.far_extent);
+                    if (!separates_points(cell, child_cells)) {
+                        is_leaf[it] = true;
+                        continue;
+                    }
+                    std::move(std::begin(child_cells), std::end(child_cells),
+                              std::back_inserter(children));
+                }
+            }
+        });
+
+    build_stats::depth_stats stats{};
+    stats.cells_processed = num_cells;
+    auto insert_start = std::chrono::steady_clock::now();
+    auto next_leaf = std::size(octree_leaves_);
+    for (size_t it = 0; it < num_cells; it++) {
+        int leaf_index = is_leaf[it] ? static_cast<int>(next_leaf++) : -1;
+        hash_table_traits<hash_type>::insert(implicit_octree_, keys[it], leaf_index);
+    }
+    stats.hash_insert_time = std::chrono::duration_cast<build_stats::duration>(
+        std::chrono::steady_clock::now() - insert_start);
+    stats.leaves_emitted = next_leaf - std::size(octree_leaves_);
+    for (size_t it = 0; it < num_cells; it++) {
+        if (is_leaf[it]) {
+            auto& leaf = octree_leaves_.emplace_back(std::move(octree_cells_[it]));
+            // Leaves are never split during construction, so their orderings are no longer needed
+            leaf.sorted_positions = {};
         } else {
-            octree_leaves_.emplace_back(std::move(cell));
+            stats.points_in_split_cells += octree_cells_[it].size();
+        }
+    }
+    stats.cells_split = num_cells - stats.leaves_emitted;
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+        stats.split_time += split_time_per_chunk[chunk];
+        for (auto& child : children_per_chunk[chunk]) {
+            stats.points_pushed_to_children += child.size();
+            split_cells.emplace_back(std::move(child));
         }
     }
     std::swap(split_cells, octree_cells_);
+    return stats;
+}
+
+template <typename point_type, typename hash_type>
+template <typename Callback>
+auto nearest_neighbor<point_type, hash_type>::for_each_within_radius(const point_type& query_point,
+                                                                     coordinate_type radius,
+                                                                     Callback callback) const
+    -> void {
+    using box_type = detail::bounding_box<point_type>;
+    if (!root_cell_.box.contains(query_point)) {
+        throw std::invalid_argument("Query point outside bounding box of construction point set");
+    }
+    if (radius < 0) return;
+    auto radius_squared = radius * radius;
+
+    auto scan_leaf = [&](int leaf, int depth, const hash_table_key_type& key) {
+        for (auto it = leaf_points_.begin(leaf); it != leaf_points_.end(leaf); ++it) {
+            if (leaf_points_.erased(*it)) continue;
+            auto distance = point_traits<point_type>::distance_squared(point(*it), query_point);
+            // The leaf containing a point is the only one that reports it
+            if (distance <= radius_squared && make_key(key_source(point(*it)), depth) == key) {
+                callback(neighbor{static_cast<index_type>(*it), distance});
+            }
+        }
+    };
+    // Internal cells overlapping the ball, whose children are resolved next
+    std::vector<std::pair<box_type, int>> internal_cells;
+    // Leaves shallower than the enumerated cells can cover several of them, but are scanned once
+    std::vector<int> shallow_leaves;
+    auto resolve_cell = [&](const box_type& box, int depth) {
+        point_type center{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            point_traits<point_type>::set(center, dim, box.mid(dim));
+        }
+        auto source = key_source(center);
+        for (auto leaf_depth = depth; leaf_depth >= 0; leaf_depth--) {
+            auto key = make_key(source, leaf_depth);
+            auto hash_entry = cell_entry(key, leaf_depth);
+            if (!hash_entry) continue;
+            if (*hash_entry == -1) {
+                internal_cells.emplace_back(box, depth);
+            } else if (leaf_depth == depth) {
+                scan_leaf(*hash_entry, leaf_depth, key);
+            } else if (std::find(std::begin(shallow_leaves), std::end(shallow_leaves),
+                                 *hash_entry) == std::end(shallow_leaves)) {
+                shallow_leaves.push_back(*hash_entry);
+                scan_leaf(*hash_entry, leaf_depth, key);
+            }
+            return;
+        }
+    };
+
+    // At most two cells per dimension overlap the ball at the chosen depth
+    const auto& root_box = root_cell_.box;
+    auto depth = 0;
+    auto fits_ball = [&](int cell_depth) {
+        for (size_t dim = 0; dim < dimension; dim++) {
+            if (root_box.step_at_depth(dim, cell_depth) < 2 * radius) return false;
+        }
+        return true;
+    };
+    while (depth < max_depth_used_ && fits_ball(depth + 1)) {
+        depth++;
+    }
+    std::array<std::int64_t, dimension> first{};
+    std::array<std::int64_t, dimension> last{};
+    auto max_cell = (std::int64_t{1} << depth) - 1;
+    for (size_t dim = 0; dim < dimension; dim++) {
+        auto step = root_box.step_at_depth(dim, depth);
+        auto query_coordinate = point_traits<point_type>::get(query_point, dim);
+        auto cell_of = [&](coordinate_type coordinate) {
+            auto cell = std::floor((coordinate - root_box.min(dim)) / step);
+            return std::clamp(static_cast<std::int64_t>(cell), std::int64_t{0}, max_cell);
+        };
+        first[dim] = cell_of(query_coordinate - radius);
+        last[dim] = cell_of(query_coordinate + radius);
+    }
+    for (auto cell = first;;) {
+        box_type box{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto step = root_box.step_at_depth(dim, depth);
+            box.min(dim) = root_box.min(dim) + static_cast<coordinate_type>(cell[dim]) * step;
+            box.max(dim) = box.min(dim) + step;
+        }
+        if (box.distance_squared(query_point) <= radius_squared) {
+            resolve_cell(box, depth);
+        }
+        size_t dim = 0;
+        for (; dim < dimension && cell[dim] == last[dim]; dim++) {
+            cell[dim] = first[dim];
+        }
+        if (dim == dimension) break;
+        cell[dim]++;
+    }
+    while (!std::empty(internal_cells)) {
+        auto [box, cell_depth] = internal_cells.back();
+        internal_cells.pop_back();
+        for (const auto& child_box : box.sub_boxes()) {
+            if (child_box.distance_squared(query_point) <= radius_squared) {
+                resolve_cell(child_box, cell_depth + 1);
+            }
+        }
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::count_within_radius(const point_type& query_point,
+                                                                  coordinate_type radius) const
+    -> size_t {
+    size_t count = 0;
+    for_each_within_radius(query_point, radius, [&count](const neighbor&) { count++; });
+    return count;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::insert(const point_type& new_point) -> index_type {
+    checked_locate_leaf(new_point);
+    std::vector<index_type> seen;
+    auto reached_leaves = find_reached_leaves(new_point, seen);
+
+    auto new_index = leaf_points_.add_point(new_point);
+    for (auto& [leaf, cell] : reached_leaves) {
+        cell.indices.push_back(new_index);
+        replace_leaf(leaf, std::move(cell));
+    }
+    return new_index;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::erase(const point_type& erased_point) -> index_type {
+    auto [index, distance_squared] = find_nearest_neighbor_with_distance(erased_point);
+    if (distance_squared != 0) {
+        throw std::invalid_argument("Point to erase isn't in the data structure");
+    }
+    erase(index);
+    return index;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::erase(index_type index) -> void {
+    if (index >= leaf_points_.num_points() || leaf_points_.erased(index)) {
+        throw std::invalid_argument("Point to erase isn't in the data structure");
+    }
+    if (leaf_points_.num_live_points() == 1) {
+        throw std::invalid_argument("The last point of the data structure can't be erased");
+    }
+    std::vector<index_type> seen;
+    auto reached_leaves = find_reached_leaves(point(index), seen);
+    leaf_points_.erase_point(index);
+
+    // A point whose Voronoi cell grows into a reached leaf shares a facet with the Voronoi cell of
+    // the erased point inside of the root box, so it's held by one of the reached leaves
+    std::sort(std::begin(seen), std::end(seen));
+    seen.erase(std::unique(std::begin(seen), std::end(seen)), std::end(seen));
+    seen.erase(std::remove(std::begin(seen), std::end(seen), index), std::end(seen));
+    std::vector<octree_cell_type> repaired_cells;
+    for (auto& [leaf, cell] : reached_leaves) {
+        auto& indices = cell.indices;
+        indices.erase(std::remove(std::begin(indices), std::end(indices), index), std::end(indices));
+        std::sort(std::begin(indices), std::end(indices));
+        auto num_kept = std::size(indices);
+        for (auto candidate : seen) {
+            if (std::binary_search(std::begin(indices), std::begin(indices) + num_kept, candidate)) {
+                continue;
+            }
+            auto shadowed = std::any_of(std::begin(seen), std::end(seen), [&](index_type other) {
+                return cell.box.closer_everywhere(point(other), point(candidate));
+            });
+            if (!shadowed) {
+                indices.push_back(candidate);
+            }
+        }
+        auto& repaired = repaired_cells.emplace_back();
+        repaired.box = cell.box;
+        repaired.depth_ = cell.depth();
+        replace_leaf(leaf, std::move(cell));
+    }
+    for (auto& cell : repaired_cells) {
+        merge_leaves_upwards(std::move(cell));
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::find_reached_leaves(
+    const point_type& target, std::vector<index_type>& seen) const
+    -> std::vector<std::pair<int, octree_cell_type>> {
+    // Every point in the data structure bounds the Voronoi cell of target, so the points of the
+    // leaves seen so far rule out the cells the Voronoi cell can't reach. Cells are searched from
+    // the closest to target outwards, so that the closest points are found first
+    auto unreachable = [&](const detail::bounding_box<point_type>& box) {
+        return std::any_of(std::begin(seen), std::end(seen), [&](index_type other) {
+            return box.closer_everywhere(point(other), target);
+        });
+    };
+    using queued_cell = std::pair<coordinate_type, octree_cell_type>;
+    auto farther = [](const queued_cell& a, const queued_cell& b) { return a.first > b.first; };
+    std::priority_queue<queued_cell, std::vector<queued_cell>, decltype(farther)> cells(farther);
+    octree_cell_type root{};
+    root.box = root_cell_.box;
+    cells.push({0, std::move(root)});
+
+    std::vector<std::pair<int, octree_cell_type>> reached_leaves;
+    while (!std::empty(cells)) {
+        auto cell = cells.top().second;
+        cells.pop();
+        if (unreachable(cell.box)) continue;
+        auto hash_entry = cell_entry(cell_key(cell, cell.depth()), cell.depth());
+        assert(hash_entry != std::nullopt);
+        if (*hash_entry != -1) {
+            auto leaf = *hash_entry;
+            for (auto it = leaf_points_.begin(leaf); it != leaf_points_.end(leaf); ++it) {
+                // Erased points left in leaves that no query reaches them from are dropped here
+                if (!leaf_points_.erased(*it)) {
+                    cell.indices.push_back(*it);
+                }
+            }
+            seen.insert(std::end(seen), std::begin(cell.indices), std::end(cell.indices));
+            if (!unreachable(cell.box)) {
+                reached_leaves.emplace_back(leaf, std::move(cell));
+            }
+            continue;
+        }
+        for (const auto& child_box : cell.box.sub_boxes()) {
+            if (!unreachable(child_box)) {
+                octree_cell_type child{};
+                child.box = child_box;
+                child.depth_ = cell.depth() + 1;
+                cells.push({child_box.distance_squared(target), std::move(child)});
+            }
+        }
+    }
+    return reached_leaves;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::replace_leaf(int leaf, octree_cell_type cell)
+    -> void {
+    auto store_leaf = [&](int index, const octree_cell_type& leaf_cell,
+                          const std::vector<index_type>& indices) {
+        leaf_points_.assign_leaf(index, indices);
+        assign_cell_entry(cell_key(leaf_cell, leaf_cell.depth()), leaf_cell.depth(), index);
+    };
+    if (!should_split(cell, condition_)) {
+        store_leaf(leaf, cell, cell.indices);
+        return;
+    }
+
+    // Split a copy of the leaf's points, so that splitting never touches the shared point set
+    auto global_indices = std::move(cell.indices);
+    auto leaf_point_set = std::make_shared<typename octree_cell_type::point_set_type>();
+    for (auto index : global_indices) {
+        leaf_point_set->push_back(point(index));
+    }
+    cell.point_set = std::move(leaf_point_set);
+    cell.indices.resize(std::size(global_indices));
+    std::iota(std::begin(cell.indices), std::end(cell.indices), index_type{0});
+
+    auto next_leaf = leaf;
+    std::vector<octree_cell_type> cells{std::move(cell)};
+    while (!std::empty(cells)) {
+        std::vector<octree_cell_type> children;
+        for (const auto& current : cells) {
+            max_depth_used_ = std::max(max_depth_used_, current.depth());
+            if (should_split(current, condition_)) {
+                auto child_cells =
+                    current.split_into_children(nullptr, nullptr, condition_.far_extent);
+                if (separates_points(current, child_cells)) {
+                    assign_cell_entry(cell_key(current, current.depth()), current.depth(), -1);
+                    std::move(std::begin(child_cells), std::end(child_cells),
+                              std::back_inserter(children));
+                    continue;
+                }
+            }
+            std::vector<index_type> indices;
+            for (auto local_index : current.indices) {
+                indices.push_back(global_indices[local_index]);
+            }
+            // The first leaf reuses the replaced leaf's index
+            auto leaf_index = next_leaf != -1 ? std::exchange(next_leaf, -1) : allocate_leaf();
+            store_leaf(leaf_index, current, indices);
+        }
+        cells = std::move(children);
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::merge_leaves_upwards(octree_cell_type cell) -> void {
+    while (cell.depth() > 0) {
+        point_type center{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            point_traits<point_type>::set(center, dim, cell.box.mid(dim));
+        }
+        octree_cell_type parent{};
+        parent.depth_ = cell.depth() - 1;
+        parent.box = root_cell_.box.floored_box(center, parent.depth());
+
+        std::vector<hash_table_key_type> child_keys;
+        std::vector<int> child_leaves;
+        for (const auto& child_box : parent.box.sub_boxes()) {
+            octree_cell_type child{};
+            child.box = child_box;
+            child.depth_ = cell.depth();
+            auto key = cell_key(child, child.depth());
+            auto hash_entry = cell_entry(key, child.depth());
+            // A child that was merged or split already
+            if (!hash_entry || *hash_entry == -1) return;
+            child_keys.push_back(key);
+            child_leaves.push_back(*hash_entry);
+        }
+        for (auto leaf : child_leaves) {
+            parent.indices.insert(std::end(parent.indices), leaf_points_.begin(leaf),
+                                  leaf_points_.end(leaf));
+        }
+        auto& indices = parent.indices;
+        std::sort(std::begin(indices), std::end(indices));
+        indices.erase(std::unique(std::begin(indices), std::end(indices)), std::end(indices));
+        indices.erase(std::remove_if(std::begin(indices), std::end(indices),
+                                     [&](index_type index) { return leaf_points_.erased(index); }),
+                      std::end(indices));
+        if (should_split(parent, condition_)) return;
+
+        for (const auto& key : child_keys) {
+            erase_cell_entry(key, cell.depth());
+        }
+        for (size_t it = 1; it < std::size(child_leaves); it++) {
+            leaf_points_.assign_leaf(child_leaves[it], {});
+            free_leaves_.push_back(child_leaves[it]);
+        }
+        auto merged = octree_cell_type{};
+        merged.box = parent.box;
+        merged.depth_ = parent.depth();
+        replace_leaf(child_leaves.front(), std::move(parent));
+        cell = std::move(merged);
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::use_dense_levels(size_t max_bytes) -> int {
+    static_assert(uses_lattice_keys,
+                  "Dense arrays are indexed by lattice keys, eg. model::lattice_hash_table");
+    // Stop before the number of entries no longer fits in a key
+    auto max_dense_depth = std::min(max_depth_used_, lattice_type::max_depth - 1);
+    // The number of entries of the depths before the given one, ie. the position of its first cell
+    auto level_offset = [](int depth) {
+        return dense_slot(std::uint64_t{1} << (static_cast<unsigned>(depth) * dimension), depth);
+    };
+    dense_depth_ = -1;
+    while (dense_depth_ < max_dense_depth &&
+           level_offset(dense_depth_ + 2) * sizeof(hash_table_value_type) <= max_bytes) {
+        dense_depth_++;
+    }
+    dense_levels_.assign(level_offset(dense_depth_ + 1), dense_absent);
+    for (auto depth = 0; depth <= dense_depth_; depth++) {
+        auto depth_tag = std::uint64_t{1} << (static_cast<unsigned>(depth) * dimension);
+        for (std::uint64_t cell = 0; cell < depth_tag; cell++) {
+            auto hash_entry = hash_table_traits<hash_type>::at(implicit_octree_, depth_tag | cell);
+            if (hash_entry) {
+                dense_levels_[dense_slot(depth_tag | cell, depth)] = *hash_entry;
+            }
+        }
+    }
+    dense_levels_.shrink_to_fit();
+    return dense_depth_;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::cell_entry(const hash_table_key_type& key,
+                                                         int depth) const
+    -> std::optional<hash_table_value_type> {
+    if constexpr (uses_lattice_keys) {
+        if (depth <= dense_depth_) {
+            auto entry = dense_levels_[dense_slot(key, depth)];
+            if (entry == dense_absent) return std::nullopt;
+            return entry;
+        }
+    }
+    return hash_table_traits<hash_type>::at(implicit_octree_, key);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::assign_cell_entry(const hash_table_key_type& key,
+                                                                int depth,
+                                                                hash_table_value_type value)
+    -> void {
+    hash_table_traits<hash_type>::insert_or_assign(implicit_octree_, key, value);
+    if constexpr (uses_lattice_keys) {
+        if (depth <= dense_depth_) {
+            dense_levels_[dense_slot(key, depth)] = value;
+        }
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::erase_cell_entry(const hash_table_key_type& key,
+                                                               int depth) -> void {
+    hash_table_traits<hash_type>::erase(implicit_octree_, key);
+    if constexpr (uses_lattice_keys) {
+        if (depth <= dense_depth_) {
+            dense_levels_[dense_slot(key, depth)] = dense_absent;
+        }
+    }
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::dense_slot(std::uint64_t key, int depth) -> size_t {
+    // Depth d holds 2^(d * dimension) cells, so the depths before it hold (2^(d * dimension) - 1)
+    // / (2^dimension - 1) cells; the key of a cell is its Morton code tagged by 2^(d * dimension)
+    auto depth_tag = std::uint64_t{1} << (static_cast<unsigned>(depth) * dimension);
+    auto level_offset = (depth_tag - 1) / ((std::uint64_t{1} << dimension) - 1);
+    return static_cast<size_t>(level_offset + (key ^ depth_tag));
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::allocate_leaf() -> int {
+    if (std::empty(free_leaves_)) {
+        return static_cast<int>(leaf_points_.num_leaves());
+    }
+    auto leaf = free_leaves_.back();
+    free_leaves_.pop_back();
+    return leaf;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::layout_header()
+    -> detail::serialization::file_header {
+    using traits = hash_table_traits<hash_type>;
+    static_assert(detail::serialization::has_slot_access<traits>::value,
+                  "Only hash tables whose traits expose their array of entries can be saved, eg. "
+                  "model::flat_hash_table or model::lattice_hash_table");
+    static_assert(detail::serialization::is_byte_copyable_v<point_type> &&
+                      detail::serialization::is_byte_copyable_v<hash_table_key_type> &&
+                      detail::serialization::is_byte_copyable_v<hash_table_value_type>,
+                  "Only trivially copyable points, keys and values can be saved");
+
+    detail::serialization::file_header header{};
+    header.magic = detail::serialization::magic;
+    header.version = detail::serialization::format_version;
+    header.byte_order = detail::serialization::byte_order_mark;
+    header.dimension = dimension;
+    header.coordinate_size = sizeof(coordinate_type);
+    header.point_size = sizeof(point_type);
+    header.uses_lattice_keys = uses_lattice_keys;
+    header.key_size = sizeof(hash_table_key_type);
+    header.slot_size = sizeof(typename traits::slot_type);
+    header.offset_size = sizeof(typename leaf_storage_type::offset_type);
+    header.index_size = sizeof(typename leaf_storage_type::index_type);
+    return header;
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::save(const std::string& path) const -> void {
+    using traits = hash_table_traits<hash_type>;
+    using namespace detail::serialization;
+    auto header = layout_header();
+    header.max_depth_used = max_depth_used_;
+    header.max_depth = condition_.max_depth;
+    header.max_points = condition_.max_points;
+    header.min_box_length = static_cast<double>(condition_.min_box_length);
+    header.far_extent = condition_.far_extent;
+    header.construction_set_size = construction_set_size_;
+    header.hash_table_size = traits::size(implicit_octree_);
+
+    auto array_section = [](const auto& array) {
+        return section_data{std::data(array), std::size(array), sizeof(*std::data(array))};
+    };
+    std::array<section_data, num_sections> sections{};
+    sections[root_box_section] = {&root_cell_.box, 1, sizeof(root_cell_.box)};
+    auto slots = slot_bytes(traits::slots(implicit_octree_), traits::capacity(implicit_octree_));
+    sections[hash_slot_section] = {std::data(slots), traits::capacity(implicit_octree_),
+                                   sizeof(typename traits::slot_type)};
+    sections[leaf_range_section] = array_section(leaf_points_.range_array());
+    sections[leaf_index_section] = array_section(leaf_points_.index_array());
+    sections[leaf_coordinate_section] = array_section(leaf_points_.coordinate_array());
+    sections[point_section] = array_section(leaf_points_.point_array());
+    sections[erased_section] = array_section(leaf_points_.erased_array());
+    write_file(path, header, sections);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::load(const std::string& path,
+                                                   std::ostream& visualize_ostream)
+    -> nearest_neighbor {
+    return open_file(path, false, visualize_ostream);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::open_mapped(const std::string& path,
+                                                          std::ostream& visualize_ostream)
+    -> nearest_neighbor {
+    return open_file(path, true, visualize_ostream);
+}
+
+template <typename point_type, typename hash_type>
+auto nearest_neighbor<point_type, hash_type>::open_file(const std::string& path, bool map,
+                                                        std::ostream& visualize_ostream)
+    -> nearest_neighbor {
+    using traits = hash_table_traits<hash_type>;
+    using slot_type = typename traits::slot_type;
+    using leaf_range = typename leaf_storage_type::leaf_range;
+    using leaf_index_type = typename leaf_storage_type::index_type;
+    using namespace detail::serialization;
+    using box_type = detail::bounding_box<point_type>;
+
+    auto contents = file_contents::open(path, map);
+    auto header = validate(*contents, layout_header(),
+                           {sizeof(box_type), sizeof(slot_type), sizeof(leaf_range),
+                            sizeof(leaf_index_type), sizeof(coordinate_type), sizeof(point_type),
+                            sizeof(std::uint8_t)});
+    const auto& sections = header.sections;
+    if (sections[root_box_section].count != 1) {
+        throw std::runtime_error("Invalid index file: missing root box");
+    }
+    auto borrow = [&](auto element, section id) {
+        using element_type = decltype(element);
+        return detail::buffer<element_type>{
+            section_elements<element_type>(*contents, header, id),
+            static_cast<size_t>(sections[id].count)};
+    };
+
+    nearest_neighbor locator;
+    locator.root_cell_.box = *section_elements<box_type>(*contents, header, root_box_section);
+    locator.lattice_ = lattice_type{locator.root_cell_.box};
+    locator.max_depth_used_ = header.max_depth_used;
+    locator.construction_set_size_ = header.construction_set_size;
+    locator.condition_ = {header.min_box_length, header.max_depth, header.max_points};
+    locator.condition_.far_extent = header.far_extent;
+    locator.drawer_ = visualize::geometry_drawer{visualize_ostream, dimension};
+    const auto* slots = section_elements<slot_type>(*contents, header, hash_slot_section);
+    auto capacity = static_cast<size_t>(sections[hash_slot_section].count);
+    // Lookups rely on the empty slots that the size leaves to stop probing
+    auto num_occupied = std::count_if(slots, slots + capacity,
+                                      [](const slot_type& slot) { return slot.occupied; });
+    if (static_cast<std::uint64_t>(num_occupied) != header.hash_table_size) {
+        throw std::runtime_error("Invalid index file: hash table size doesn't match its slots");
+    }
+    locator.implicit_octree_ = traits::view(slots, capacity, header.hash_table_size);
+    locator.leaf_points_ = leaf_storage_type{
+        borrow(point_type{}, point_section), borrow(leaf_range{}, leaf_range_section),
+        borrow(leaf_index_type{}, leaf_index_section),
+        borrow(coordinate_type{}, leaf_coordinate_section),
+        borrow(std::uint8_t{}, erased_section), std::move(contents)};
+    // Only the leaves merged into their parents are empty
+    for (size_t leaf = 0; leaf < locator.leaf_points_.num_leaves(); leaf++) {
+        if (locator.leaf_points_.size(leaf) == 0) {
+            locator.free_leaves_.push_back(static_cast<int>(leaf));
+        }
+    }
+
+    // The root cell is always in the table, so failing to find it means the hash function differs
+    // from the one the file was saved with
+    auto root_key = locator.cell_key(locator.root_cell_, 0);
+    if (!traits::at(locator.implicit_octree_, root_key)) {
+        throw std::runtime_error("Invalid index file: saved with a different hash function");
+    }
+    return locator;
 }
 
 }  // namespace implicit_octree_nns
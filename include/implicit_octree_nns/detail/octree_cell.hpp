@@ -4,10 +4,17 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "implicit_octree_nns/build_stats.hpp"
 #include "implicit_octree_nns/detail/axis_aligned.hpp"
 #include "implicit_octree_nns/detail/bounding_box.hpp"
 #include "implicit_octree_nns/detail/equation_hull.hpp"
@@ -16,78 +23,340 @@
 
 namespace implicit_octree_nns::detail {
 
+/**
+ * The default of splitting_condition::far_extent: how many times longer than the box a side of the
+ * extent of a cell's points must be for the points outside of the box to be checked against the
+ * nearest points to the children's centers
+ */
+constexpr double default_far_extent = 4;
+
+/**
+ * @brief Buffers for the temporaries of octree_cell::split_into_children, reused by every split of
+ * one thread so that they're only reallocated when a cell has more points than any cell before it
+ */
+template <typename point_type>
+struct split_scratch {
+    using coordinate_type = typename point_traits<point_type>::coordinate_type;
+    static constexpr auto dimension = point_traits<point_type>::dimension;
+
+    std::vector<uint8_t> initial_bitmask;
+    std::vector<uint8_t> transition_bitmask;
+    /** The children that each point of the split cell is dropped from, one bit per child */
+    std::vector<uint8_t> dropped_children;
+    /** The positions of the points of the split cell that are outside of its box */
+    std::vector<std::uint32_t> outside_points;
+    std::vector<equation<coordinate_type, dimension>> equations;
+    equation_hull<coordinate_type, dimension> hull;
+    /** The position of each point of the split cell in each child it reaches, by child */
+    std::vector<std::uint32_t> child_positions;
+};
+
+/**
+ * @brief A cell of the octree, holding the indices of its points into a point set that is shared by
+ * every cell split from the same root
+ */
 template <typename point_type>
 struct octree_cell {
     using coordinate_type = typename point_traits<point_type>::coordinate_type;
     static constexpr auto dimension = point_traits<point_type>::dimension;
+    using index_type = std::uint32_t;
+    using point_set_type = std::vector<point_type>;
 
     octree_cell() = default;
+    /**
+     * Creates a root cell containing a copy of the point set, which the cells split from it share
+     */
     template <typename ForwardIterator>
     explicit octree_cell(ForwardIterator point_set_begin, ForwardIterator point_set_end,
                          coordinate_type max_magnitude = 0)
-        : points(point_set_begin, point_set_end) {
-        if (max_magnitude == 0) {
-            max_magnitude = get_max_magnitude(point_set_begin, point_set_end);
+        : octree_cell(point_set_begin, point_set_end,
+                      bounding_box<point_type>(
+                          max_magnitude != 0
+                              ? max_magnitude
+                              : get_max_magnitude(point_set_begin, point_set_end))) {}
+    /**
+     * Same as above, but the root cell's box is root_box instead of the cube centered on the origin
+     *
+     * @pre root_box contains every point of the point set
+     */
+    template <typename ForwardIterator>
+    octree_cell(ForwardIterator point_set_begin, ForwardIterator point_set_end,
+                const bounding_box<point_type>& root_box)
+        : box(root_box),
+          point_set(std::make_shared<const point_set_type>(point_set_begin, point_set_end)) {
+        if (std::size(*point_set) > std::numeric_limits<index_type>::max()) {
+            throw std::length_error("Too many points to be indexed by octree cells");
+        }
+        indices.resize(std::size(*point_set));
+        std::iota(std::begin(indices), std::end(indices), index_type{0});
+        if constexpr (dimension == 2) {
+            sort_positions();
         }
-        box = bounding_box<point_type>(max_magnitude);
     }
 
-    auto split_into_children() const -> std::array<octree_cell, (1u << dimension)> {
-        std::array<octree_cell, (1u << dimension)> children{};
+    /**
+     * Sorts the positions of the points by each of their coordinates, breaking ties by position
+     * (see sorted_positions)
+     */
+    auto sort_positions() {
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto& positions = sorted_positions[dim];
+            positions.resize(size());
+            std::iota(std::begin(positions), std::end(positions), index_type{0});
+            std::sort(std::begin(positions), std::end(positions), [&](index_type a, index_type b) {
+                auto a_coordinate = point_traits<point_type>::get(point(a), dim);
+                auto b_coordinate = point_traits<point_type>::get(point(b), dim);
+                return std::tie(a_coordinate, a) < std::tie(b_coordinate, b);
+            });
+        }
+    }
+
+    /**
+     * @param timings If not null, the time spent in each stage of the split is added to it
+     * @param scratch If not null, the buffers used for the temporaries of the split; the buffers
+     * of one call are never used by another, so each thread needs its own
+     * @param far_extent How many times longer than the box a side of the extent of the points must
+     * be for the points outside of the box to be dropped from the children they can't be nearest to
+     * (see splitting_condition::far_extent)
+     */
+    auto split_into_children(build_stats::split_timings* timings = nullptr,
+                             split_scratch<point_type>* scratch = nullptr,
+                             double far_extent = default_far_extent) const
+        -> std::array<octree_cell, (1u << dimension)> {
+        using clock = std::chrono::steady_clock;
+        build_stats::split_timings elapsed{};
+        auto stage_start = clock::now();
+        auto end_stage = [&stage_start]() {
+            auto now = clock::now();
+            auto stage_time = now - std::exchange(stage_start, now);
+            return std::chrono::duration_cast<build_stats::duration>(stage_time);
+        };
+
+        constexpr auto num_children = 1u << dimension;
+        std::array<octree_cell, num_children> children{};
         auto octants = box.sub_boxes();
         assert(octants.size() == children.size());
         for (size_t it = 0; it < octants.size(); it++) {
             children[it].box = octants[it];
+            children[it].point_set = point_set;
             children[it].depth_ = depth() + 1;
         }
-        std::vector<uint8_t> initial_bitmask(points.size());
-        std::vector<uint8_t> transition_bitmask(points.size());
-        for (size_t it = 0; it < points.size(); it++) {
-            initial_bitmask[it] = box.octant_index(points[it]);
+        split_scratch<point_type> local_scratch;
+        auto& buffers = scratch != nullptr ? *scratch : local_scratch;
+        auto& initial_bitmask = buffers.initial_bitmask;
+        auto& transition_bitmask = buffers.transition_bitmask;
+        auto& dropped_children = buffers.dropped_children;
+        initial_bitmask.resize(size());
+        transition_bitmask.assign(size(), 0);
+        dropped_children.assign(size(), 0);
+        auto& outside_points = buffers.outside_points;
+        outside_points.clear();
+        auto extent = box;
+        for (size_t it = 0; it < size(); it++) {
+            const auto& current = point(it);
+            initial_bitmask[it] = box.octant_index(current);
+            if (box.contains(current)) continue;
+            outside_points.push_back(static_cast<std::uint32_t>(it));
+            for (size_t dim = 0; dim < dimension; dim++) {
+                auto coordinate = point_traits<point_type>::get(current, dim);
+                extent.min(dim) = std::min(extent.min(dim), coordinate);
+                extent.max(dim) = std::max(extent.max(dim), coordinate);
+            }
+        }
+        auto any_outside = !outside_points.empty();
+        auto far_outside = false;
+        auto far_length_ratio = static_cast<coordinate_type>(far_extent);
+        for (size_t dim = 0; dim < dimension; dim++) {
+            far_outside = far_outside || extent.length(dim) > far_length_ratio * box.length(dim);
+        }
+        elapsed.octant_bitmasking = end_stage();
+        // The Voronoi region of a point in the box contains the point, so it can only reach another
+        // child by crossing the split lines/planes between them within the box. A point outside of
+        // the box can also cross them outside of the box on its way to a child, so its crossings
+        // are searched within the extent of both the box and the points
+        // The equations are relative to the center of the box, so their precision follows the size
+        // of the box rather than its distance from the origin
+        point_type center{};
+        auto local_box = box;
+        for (size_t dim = 0; dim < dimension; dim++) {
+            point_traits<point_type>::set(center, dim, box.mid(dim));
+            for (auto* range : {&local_box, &extent}) {
+                range->min(dim) -= box.mid(dim);
+                range->max(dim) -= box.mid(dim);
+            }
         }
         for (int dim = 0; dim < dimension; dim++) {
-            axis_aligned<point_type> split_line{static_cast<axes>(dim), box.mid(dim)};
-            std::vector<equation<coordinate_type, dimension>> equations(points.size());
-            std::transform(std::begin(points), std::end(points), std::begin(equations),
-                           [&split_line](const point_type& point) {
-                               return split_line.make_distance_equation(point);
-                           });
-            equation_hull<coordinate_type, dimension> hull(std::begin(equations),
-                                                           std::end(equations));
-            int next_dim = (dim + 1) == dimension ? 0 : dim + 1;
-            const auto& crossed_split_line =
-                hull.lower_envelope(box.min(next_dim), box.max(next_dim));
-            for (const auto& point_index : crossed_split_line) {
-                transition_bitmask[point_index] |= (1 << dim);
+            axis_aligned<point_type> split_line{static_cast<axes>(dim), box.mid(dim), center};
+            auto& equations = buffers.equations;
+            equations.resize(size());
+            for (size_t it = 0; it < size(); it++) {
+                equations[it] = split_line.make_distance_equation(point(it));
+            }
+            auto& hull = buffers.hull;
+            if constexpr (dimension == 2) {
+                // Ordering the points by the free coordinate orders the lines by decreasing slope
+                if (has_sorted_positions()) {
+                    const auto& order = sorted_positions[(dim + 1) % dimension];
+                    hull.build_sorted(std::begin(equations), std::begin(order), std::end(order));
+                } else {
+                    hull.build(std::begin(equations), std::end(equations));
+                }
+            } else {
+                hull.build(std::begin(equations), std::end(equations));
+            }
+            // The variables of the distance equations are the other dimensions, in order
+            int next_dim = (dim + 1) % dimension;
+            int last_dim = (dim + dimension - 1) % dimension;
+            auto crossed_split_line = [&](const bounding_box<point_type>& range) {
+                if constexpr (dimension == 2) {
+                    return hull.lower_envelope(range.min(next_dim), range.max(next_dim));
+                } else {
+                    auto [first_dim, second_dim] = std::minmax(next_dim, last_dim);
+                    return hull.lower_envelope(range.min(first_dim), range.max(first_dim),
+                                               range.min(second_dim), range.max(second_dim));
+                }
+            };
+            // Each envelope is a view that the next one overwrites
+            for (const auto& point_index : crossed_split_line(local_box)) {
+                if (box.contains(point(point_index))) {
+                    transition_bitmask[point_index] |= (1 << dim);
+                }
+            }
+            if (any_outside) {
+                for (const auto& point_index : crossed_split_line(extent)) {
+                    if (!box.contains(point(point_index))) {
+                        transition_bitmask[point_index] |= (1 << dim);
+                    }
+                }
             }
         }
-        for (size_t it = 0; it < points.size(); it++) {
+        elapsed.hull_building = end_stage();
+        // The extent of a cell whose points spread far beyond its box stays large however small the
+        // box gets, so then a point outside of the box is also dropped from every child that is
+        // closer everywhere to the point of the cell nearest to the child's center. Any point of
+        // the cell can rule out others, so only the points in the child are searched if it has any,
+        // and otherwise all of them, since a witness far from the child rules out almost nothing
+        if (far_outside) {
+            std::array<point_type, num_children> child_centers{};
+            for (size_t child = 0; child < num_children; child++) {
+                for (size_t dim = 0; dim < dimension; dim++) {
+                    auto mid = octants[child].mid(dim);
+                    point_traits<point_type>::set(child_centers[child], dim, mid);
+                }
+            }
+            constexpr auto no_point = std::numeric_limits<coordinate_type>::max();
+            std::array<index_type, num_children> nearest_to_center{};
+            std::array<coordinate_type, num_children> nearest_distance{};
+            nearest_distance.fill(no_point);
+            auto update_nearest = [&](size_t child, size_t it) {
+                auto distance =
+                    point_traits<point_type>::distance_squared(point(it), child_centers[child]);
+                if (distance < nearest_distance[child]) {
+                    nearest_distance[child] = distance;
+                    nearest_to_center[child] = static_cast<index_type>(it);
+                }
+            };
+            for (size_t it = 0; it < size(); it++) {
+                if (box.contains(point(it))) update_nearest(initial_bitmask[it], it);
+            }
+            for (size_t child = 0; child < num_children; child++) {
+                if (nearest_distance[child] != no_point) continue;
+                for (size_t it = 0; it < size(); it++) {
+                    update_nearest(child, it);
+                }
+            }
+            for (auto it : outside_points) {
+                for (size_t child = 0; child < num_children; child++) {
+                    const auto& nearest = point(nearest_to_center[child]);
+                    if (octants[child].closer_everywhere(nearest, point(it))) {
+                        dropped_children[it] |= 1u << child;
+                    }
+                }
+            }
+        }
+        elapsed.far_point_dropping = end_stage();
+        auto for_each_child = [&](size_t it, auto callback) {
             for_each_submask(transition_bitmask[it], [&](int transition) {
-                auto end_mask = initial_bitmask[it] ^ transition;
-                children[end_mask].points.push_back(points[it]);
+                auto child = initial_bitmask[it] ^ transition;
+                if (((dropped_children[it] >> child) & 1u) == 0) callback(child);
+            });
+        };
+        // Counting the points of each child first sizes their indices with a single allocation
+        std::array<size_t, num_children> child_sizes{};
+        for (size_t it = 0; it < size(); it++) {
+            for_each_child(it, [&](int child) { child_sizes[child]++; });
+        }
+        for (size_t it = 0; it < children.size(); it++) {
+            children[it].indices.reserve(child_sizes[it]);
+        }
+        auto& child_positions = buffers.child_positions;
+        if (has_sorted_positions()) {
+            child_positions.resize(num_children * size());
+        }
+        for (size_t it = 0; it < size(); it++) {
+            for_each_child(it, [&](int child) {
+                auto& child_indices = children[child].indices;
+                if (has_sorted_positions()) {
+                    child_positions[num_children * it + child] =
+                        static_cast<index_type>(std::size(child_indices));
+                }
+                child_indices.push_back(indices[it]);
             });
         }
+        // A child's points keep the order they have in the parent, so its sorted positions are
+        // the parent's with the points that don't reach it filtered out
+        if (has_sorted_positions()) {
+            for (size_t dim = 0; dim < dimension; dim++) {
+                for (size_t it = 0; it < num_children; it++) {
+                    children[it].sorted_positions[dim].reserve(child_sizes[it]);
+                }
+                for (auto position : sorted_positions[dim]) {
+                    for_each_child(position, [&](int child) {
+                        children[child].sorted_positions[dim].push_back(
+                            child_positions[num_children * position + child]);
+                    });
+                }
+            }
+        }
+        elapsed.child_distribution = end_stage();
+        if (timings != nullptr) {
+            *timings += elapsed;
+        }
         return children;
     }
 
     auto closest_point(const point_type& query_point) const -> point_type {
-        assert(!points.empty());
-        return *std::min_element(std::begin(points), std::end(points),
-                                 [&](const auto& cell_point_1, const auto& cell_point_2) {
-                                     auto distance_1 = point_traits<point_type>::distance_squared(
-                                         query_point, cell_point_1);
-                                     auto distance_2 = point_traits<point_type>::distance_squared(
-                                         query_point, cell_point_2);
-                                     return distance_1 < distance_2;
-                                 });
+        assert(!indices.empty());
+        auto closest = indices.front();
+        auto closest_distance = std::numeric_limits<coordinate_type>::max();
+        for (auto index : indices) {
+            auto distance =
+                point_traits<point_type>::distance_squared(query_point, (*point_set)[index]);
+            if (distance < closest_distance) {
+                closest = index;
+                closest_distance = distance;
+            }
+        }
+        return (*point_set)[closest];
     }
 
+    /** @return The it-th point of the cell */
+    const auto& point(size_t it) const { return (*point_set)[indices[it]]; }
+
     auto length(int dim) const { return box.length(dim); }
-    auto size() const { return points.size(); }
+    auto size() const { return indices.size(); }
     auto depth() const { return depth_; }
+    auto has_sorted_positions() const { return std::size(sorted_positions[0]) == size(); }
 
     bounding_box<point_type> box{};
-    std::vector<point_type> points{};
+    std::shared_ptr<const point_set_type> point_set{};
+    std::vector<index_type> indices{};
+    /**
+     * The positions of the points in indices, sorted by each coordinate. Splitting a cell filters
+     * them into its children, so the equation hulls of the split lines are built without sorting;
+     * only 2D cells split from a root cell keep them, since the 3D hulls don't sort their planes
+     */
+    std::array<std::vector<index_type>, dimension> sorted_positions{};
     int depth_{0};
 };
 
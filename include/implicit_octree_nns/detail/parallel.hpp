@@ -0,0 +1,181 @@
+#ifndef IMPLICIT_OCTREE_NNS_PARALLEL_HPP
+#define IMPLICIT_OCTREE_NNS_PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace implicit_octree_nns::detail {
+
+/**
+ * @return The number of threads used when 0 is requested: one per hardware thread
+ */
+inline auto resolve_num_threads(unsigned num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return num_threads;
+}
+
+/**
+ * Splits [0, size) into at most num_threads contiguous chunks of (almost) equal size, and calls
+ * callback(chunk_index, chunk_begin, chunk_end) for every chunk, each on its own thread. The first
+ * chunk runs on the calling thread, so a single chunk never starts a thread. Chunk i always covers
+ * indices before those of chunk i + 1, which lets callers merge per-chunk results deterministically
+ *
+ * If any callback throws, the first exception (by chunk index) is rethrown once all chunks finish
+ *
+ * @return The number of chunks that were used
+ */
+template <typename Callback>
+auto parallel_for_chunks(size_t size, unsigned num_threads, Callback callback) {
+    auto num_chunks = std::max(size_t{1}, std::min(size, size_t{resolve_num_threads(num_threads)}));
+    auto chunk_begin = [&](size_t chunk) { return size * chunk / num_chunks; };
+    std::vector<std::exception_ptr> errors(num_chunks);
+    auto run_chunk = [&](size_t chunk) {
+        try {
+            callback(chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(num_chunks - 1);
+    for (size_t chunk = 1; chunk < num_chunks; chunk++) {
+        workers.emplace_back(run_chunk, chunk);
+    }
+    run_chunk(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return num_chunks;
+}
+
+/**
+ * @brief A fixed pool of worker threads that repeatedly runs chunked work
+ *
+ * Unlike parallel_for_chunks, the threads are started once and reused by every call to
+ * for_each_chunk, which makes the pool cheap enough to use for many small batches
+ */
+class thread_pool {
+   public:
+    /**
+     * @param num_threads The number of threads work is spread over, including the thread calling
+     * for_each_chunk; 0 uses one thread per hardware thread
+     */
+    explicit thread_pool(unsigned num_threads) {
+        num_threads = resolve_num_threads(num_threads);
+        errors_.resize(num_threads);
+        workers_.reserve(num_threads - 1);
+        for (unsigned worker = 1; worker < num_threads; worker++) {
+            workers_.emplace_back([this, worker] { work(worker); });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard lock{mutex_};
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    auto size() const { return static_cast<unsigned>(std::size(workers_) + 1); }
+
+    /**
+     * Same as parallel_for_chunks, except that the chunks are run by the threads of the pool.
+     * Concurrent calls are serialized
+     */
+    template <typename Callback>
+    auto for_each_chunk(size_t size, Callback callback) {
+        std::lock_guard run_lock{run_mutex_};
+        auto num_chunks = std::max(size_t{1}, std::min(size, size_t{this->size()}));
+        auto chunk_begin = [&](size_t chunk) { return size * chunk / num_chunks; };
+        task_ = [&](size_t chunk) {
+            if (chunk < num_chunks) {
+                callback(chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+            }
+        };
+        {
+            std::lock_guard lock{mutex_};
+            pending_ = std::size(workers_);
+            generation_++;
+        }
+        work_ready_.notify_all();
+        run_task(0);
+        {
+            std::unique_lock lock{mutex_};
+            work_done_.wait(lock, [this] { return pending_ == 0; });
+        }
+        task_ = nullptr;
+        // Every error is cleared before rethrowing, so a later batch never sees one from this one
+        auto first_error = std::find_if(std::begin(errors_), std::end(errors_),
+                                        [](const auto& error) { return error != nullptr; });
+        auto error = first_error == std::end(errors_) ? nullptr : *first_error;
+        std::fill(std::begin(errors_), std::end(errors_), nullptr);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return num_chunks;
+    }
+
+   private:
+    void run_task(size_t chunk) {
+        try {
+            task_(chunk);
+        } catch (...) {
+            errors_[chunk] = std::current_exception();
+        }
+    }
+
+    void work(size_t worker) {
+        size_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock lock{mutex_};
+                work_ready_.wait(lock,
+                                 [&] { return stopping_ || generation_ != seen_generation; });
+                if (stopping_) {
+                    return;
+                }
+                seen_generation = generation_;
+            }
+            run_task(worker);
+            {
+                std::lock_guard lock{mutex_};
+                pending_--;
+            }
+            work_done_.notify_one();
+        }
+    }
+
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    std::function<void(size_t)> task_;
+    std::vector<std::exception_ptr> errors_;
+    size_t generation_{0};
+    size_t pending_{0};
+    bool stopping_{false};
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace implicit_octree_nns::detail
+
+#endif  // IMPLICIT_OCTREE_NNS_PARALLEL_HPP
@@ -0,0 +1,328 @@
+#ifndef IMPLICIT_OCTREE_NNS_SERIALIZATION_HPP
+#define IMPLICIT_OCTREE_NNS_SERIALIZATION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IMPLICIT_OCTREE_NNS_HAS_MMAP
+#endif
+
+namespace implicit_octree_nns::detail::serialization {
+
+/**
+ * The layout of a saved index file:
+ * - A file_header, which describes the saved types and where each section starts
+ * - One section per array of the index, each aligned to section_alignment bytes and stored exactly
+ *   as it is laid out in memory, so the index can use the sections of a mapped file in place
+ *
+ * Sections are located by their offset from the start of the file, so the file doesn't depend on
+ * the address it's loaded at. It does depend on the native layout of the saved types and on the
+ * hash function of the hash table, so a file can only be opened by a build with the same point,
+ * coordinate and hash table types on a machine with the same byte order
+ */
+constexpr std::array<char, 8> magic = {'I', 'O', 'N', 'N', 'I', 'D', 'X', '\0'};
+/**
+ * Bumped whenever the layout of the file changes; version 2 stores a range per leaf, version 3 the
+ * tombstones of erased points, and version 4 the far extent of the splitting condition
+ */
+constexpr std::uint32_t format_version = 4;
+/** Reads back as a different value on a machine with a different byte order */
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+constexpr std::uint64_t section_alignment = 64;
+
+enum section : size_t {
+    root_box_section,
+    hash_slot_section,
+    leaf_range_section,
+    leaf_index_section,
+    leaf_coordinate_section,
+    point_section,
+    erased_section,
+    num_sections
+};
+
+struct section_entry {
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+struct file_header {
+    std::array<char, 8> magic{};
+    std::uint32_t version{0};
+    std::uint32_t byte_order{0};
+
+    // The layout of the saved types, which must match the types of the loading index
+    std::uint32_t dimension{0};
+    std::uint32_t coordinate_size{0};
+    std::uint32_t point_size{0};
+    std::uint32_t uses_lattice_keys{0};
+    std::uint32_t key_size{0};
+    std::uint32_t slot_size{0};
+    std::uint32_t offset_size{0};
+    std::uint32_t index_size{0};
+
+    // The scalar members of the index
+    std::int32_t max_depth_used{0};
+    std::int32_t max_depth{0};
+    std::int32_t max_points{0};
+    std::uint32_t reserved{0};
+    double min_box_length{0};
+    double far_extent{0};
+    std::uint64_t construction_set_size{0};
+    std::uint64_t hash_table_size{0};
+
+    std::uint64_t file_size{0};
+    std::array<section_entry, num_sections> sections{};
+};
+static_assert(std::is_trivially_copyable_v<file_header>);
+
+/**
+ * Whether values of type T can be saved by copying their bytes. std::pair is never trivially
+ * copyable because of its assignment operators, but a pair of such types is copied bytewise safely
+ */
+template <typename T>
+struct is_byte_copyable : std::is_trivially_copyable<T> {};
+
+template <typename T, typename U>
+struct is_byte_copyable<std::pair<T, U>>
+    : std::bool_constant<is_byte_copyable<T>::value && is_byte_copyable<U>::value> {};
+
+template <typename T>
+constexpr auto is_byte_copyable_v = is_byte_copyable<T>::value;
+
+/** Whether hash_table_traits exposes the array of entries of its hash table (see view) */
+template <typename traits, typename = void>
+struct has_slot_access : std::false_type {};
+
+template <typename traits>
+struct has_slot_access<traits, std::void_t<typename traits::slot_type>> : std::true_type {};
+
+/** The bytes of one section to be written */
+struct section_data {
+    const void* data;
+    std::uint64_t count;
+    std::uint64_t element_size;
+};
+
+constexpr auto align_up(std::uint64_t offset) {
+    return (offset + section_alignment - 1) / section_alignment * section_alignment;
+}
+
+/**
+ * Writes header followed by the given sections to the file at path, filling in the section table
+ * and the file size of the header
+ */
+inline void write_file(const std::string& path, file_header header,
+                       const std::array<section_data, num_sections>& sections) {
+    auto offset = align_up(sizeof(file_header));
+    for (size_t it = 0; it < num_sections; it++) {
+        header.sections[it] = {offset, sections[it].count};
+        offset = align_up(offset + sections[it].count * sections[it].element_size);
+    }
+    header.file_size = offset;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Could not open " + path + " for writing");
+    }
+    const std::array<char, section_alignment> padding{};
+    auto written = std::uint64_t{sizeof(file_header)};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(file_header));
+    for (size_t it = 0; it < num_sections; it++) {
+        auto bytes = sections[it].count * sections[it].element_size;
+        auto padding_bytes = header.sections[it].offset - written;
+        file.write(padding.data(), static_cast<std::streamsize>(padding_bytes));
+        file.write(static_cast<const char*>(sections[it].data),
+                   static_cast<std::streamsize>(bytes));
+        written = header.sections[it].offset + bytes;
+    }
+    file.write(padding.data(), static_cast<std::streamsize>(header.file_size - written));
+    if (!file.flush()) {
+        throw std::runtime_error("Could not write index to " + path);
+    }
+}
+
+/**
+ * @brief The contents of a saved index file, either mapped into memory or read into a buffer
+ */
+class file_contents {
+   public:
+    file_contents(const file_contents&) = delete;
+    file_contents& operator=(const file_contents&) = delete;
+
+    ~file_contents() {
+#ifdef IMPLICIT_OCTREE_NNS_HAS_MMAP
+        if (mapping_ != nullptr) {
+            munmap(mapping_, size_);
+        }
+#endif
+    }
+
+    /**
+     * @param map Whether to map the file instead of reading it; files are always read on systems
+     * without mmap
+     */
+    static auto open(const std::string& path, bool map) {
+        auto contents = std::shared_ptr<file_contents>(new file_contents{});
+#ifdef IMPLICIT_OCTREE_NNS_HAS_MMAP
+        if (map) {
+            contents->map(path);
+            return std::shared_ptr<const file_contents>{std::move(contents)};
+        }
+#endif
+        contents->read(path);
+        return std::shared_ptr<const file_contents>{std::move(contents)};
+    }
+
+    auto data() const { return data_; }
+    auto size() const { return size_; }
+
+   private:
+    file_contents() = default;
+
+#ifdef IMPLICIT_OCTREE_NNS_HAS_MMAP
+    void map(const std::string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("Could not open index file " + path);
+        }
+        struct stat status {};
+        if (fstat(fd, &status) == -1 || status.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Could not map index file " + path);
+        }
+        size_ = static_cast<size_t>(status.st_size);
+        auto* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map index file " + path);
+        }
+        mapping_ = mapping;
+        data_ = static_cast<const std::byte*>(mapping);
+    }
+#endif
+
+    void read(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            throw std::runtime_error("Could not open index file " + path);
+        }
+        size_ = static_cast<size_t>(file.tellg());
+        // max_align_t elements keep the sections as aligned as the saved types need
+        buffer_.resize((size_ + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        file.seekg(0);
+        auto* bytes = reinterpret_cast<char*>(buffer_.data());
+        if (!file.read(bytes, static_cast<std::streamsize>(size_))) {
+            throw std::runtime_error("Could not read index file " + path);
+        }
+        data_ = reinterpret_cast<const std::byte*>(buffer_.data());
+    }
+
+    const std::byte* data_{nullptr};
+    size_t size_{0};
+    void* mapping_{nullptr};
+    std::vector<std::max_align_t> buffer_{};
+};
+
+/**
+ * @return The header of contents, after checking that contents is a complete index file whose
+ * saved types have the same layout as those of expected
+ */
+inline auto validate(const file_contents& contents, const file_header& expected,
+                     const std::array<std::uint64_t, num_sections>& element_sizes) {
+    auto invalid = [](const std::string& reason) {
+        return std::runtime_error("Invalid index file: " + reason);
+    };
+    file_header header;
+    if (contents.size() < sizeof(file_header)) throw invalid("too small");
+    std::memcpy(&header, contents.data(), sizeof(file_header));
+    if (header.magic != magic) throw invalid("not an index file");
+    if (header.version != format_version) throw invalid("unsupported format version");
+    if (header.byte_order != byte_order_mark) throw invalid("different byte order");
+    if (header.dimension != expected.dimension ||
+        header.coordinate_size != expected.coordinate_size ||
+        header.point_size != expected.point_size ||
+        header.uses_lattice_keys != expected.uses_lattice_keys ||
+        header.key_size != expected.key_size || header.slot_size != expected.slot_size ||
+        header.offset_size != expected.offset_size || header.index_size != expected.index_size) {
+        throw invalid("saved with different point or hash table types");
+    }
+    if (header.file_size != contents.size()) throw invalid("truncated");
+    for (size_t it = 0; it < num_sections; it++) {
+        const auto& [offset, count] = header.sections[it];
+        if (offset % section_alignment != 0 || offset > header.file_size ||
+            count > (header.file_size - offset) / element_sizes[it]) {
+            throw invalid("section out of bounds");
+        }
+    }
+    // Lookups mask hashes to the capacity, and probe until they find the key or an empty slot
+    auto capacity = header.sections[hash_slot_section].count;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        throw invalid("hash table capacity isn't a power of two");
+    }
+    if (header.hash_table_size >= capacity) throw invalid("hash table has no empty slot");
+    return header;
+}
+
+/** @return The position of member in object, in bytes */
+template <typename Object, typename Member>
+auto member_offset(const Object& object, const Member& member) {
+    return static_cast<size_t>(reinterpret_cast<const std::byte*>(&member) -
+                               reinterpret_cast<const std::byte*>(&object));
+}
+
+/** Copies the bytes of value to out, except for the padding between the members of pairs */
+template <typename T>
+void copy_value_bytes(const T& value, std::byte* out) {
+    std::memcpy(out, &value, sizeof(T));
+}
+
+template <typename T, typename U>
+void copy_value_bytes(const std::pair<T, U>& value, std::byte* out) {
+    copy_value_bytes(value.first, out + member_offset(value, value.first));
+    copy_value_bytes(value.second, out + member_offset(value, value.second));
+}
+
+/**
+ * @return The bytes of the given hash table slots, which have key, value and occupied members, with
+ * their padding and every empty slot zeroed. Copying the slots as they are would also save the
+ * padding bytes, which hold whatever was in memory, so saving the same index twice could write
+ * different files
+ */
+template <typename slot_type>
+auto slot_bytes(const slot_type* slots, size_t capacity) {
+    std::vector<std::byte> bytes(capacity * sizeof(slot_type));
+    for (size_t it = 0; it < capacity; it++) {
+        const auto& slot = slots[it];
+        if (!slot.occupied) continue;
+        auto* out = bytes.data() + it * sizeof(slot_type);
+        copy_value_bytes(slot.key, out + member_offset(slot, slot.key));
+        copy_value_bytes(slot.value, out + member_offset(slot, slot.value));
+        copy_value_bytes(slot.occupied, out + member_offset(slot, slot.occupied));
+    }
+    return bytes;
+}
+
+/** @return The elements of the given section of contents, which was validated with header */
+template <typename T>
+auto section_elements(const file_contents& contents, const file_header& header, section id) {
+    return reinterpret_cast<const T*>(contents.data() + header.sections[id].offset);
+}
+
+}  // namespace implicit_octree_nns::detail::serialization
+
+#endif  // IMPLICIT_OCTREE_NNS_SERIALIZATION_HPP
@@ -2,6 +2,7 @@
 #define IMPLICIT_OCTREE_NNS_UTILITY_HPP
 
 #include <cstdint>
+#include <optional>
 #include <random>
 #include <vector>
 
@@ -12,6 +13,51 @@ namespace implicit_octree_nns::detail {
 
 enum class bsearch_result { too_shallow, too_deep, just_right };
 
+/**
+ * State of the binary search on the depth of the octree leaf containing a query point
+ *
+ * A hash entry of nullopt means that no cell exists at the probed depth, -1 means that the cell
+ * exists but is not a leaf, and any other value is the index of the leaf containing the query
+ */
+struct depth_search {
+    depth_search() = default;
+    explicit depth_search(int max_depth) : lo_depth{0}, hi_depth{max_depth} {}
+
+    auto done() const { return lo_depth > hi_depth; }
+    auto depth() const { return (lo_depth + hi_depth) / 2; }
+
+    auto update(std::optional<int> hash_entry) -> bsearch_result {
+        return update(depth(), hash_entry);
+    }
+
+    /**
+     * Same as update, but for a probe at any depth in [lo_depth, hi_depth] rather than the midpoint,
+     * eg. the depth of the leaf containing the previous query
+     */
+    auto update(int probed_depth, std::optional<int> hash_entry) -> bsearch_result {
+        bsearch_result result;
+        if (hash_entry == std::nullopt) {
+            result = bsearch_result::too_deep;
+            hi_depth = probed_depth - 1;
+        } else if (*hash_entry == -1) {
+            result = bsearch_result::too_shallow;
+            lo_depth = probed_depth + 1;
+        } else {
+            result = bsearch_result::just_right;
+            leaf = *hash_entry;
+            leaf_depth = probed_depth;
+            lo_depth = 1;
+            hi_depth = -1;
+        }
+        return result;
+    }
+
+    int lo_depth{0};
+    int hi_depth{-1};
+    int leaf{-1};
+    int leaf_depth{-1};
+};
+
 template <typename Callback>
 void for_each_submask(uint8_t bitmask, Callback callback) {
     for (unsigned int submask = bitmask;; submask = (submask - 1) & bitmask) {
@@ -50,11 +96,10 @@ auto get_max_magnitude(ForwardIterator point_set_begin, ForwardIterator point_se
     return max_magnitude_of_point(point_with_max_magnitude);
 }
 
-/** Random model point generator */
+/** Random model point generator, converting the drawn values to coordinate_type */
 
-template <int dimension, typename distribution_type>
+template <int dimension, typename coordinate_type = double, typename distribution_type>
 auto generate_random_points(int n, std::mt19937& generator, distribution_type distribution) {
-    using coordinate_type = double;
     using point_type = implicit_octree_nns::model::point<coordinate_type, dimension>;
     auto result = std::vector<point_type>(n);
     for (auto& pt : result) {
@@ -1,6 +1,8 @@
 #ifndef IMPLICIT_OCTREE_NNS_HASH_TABLE_TRAITS_HPP
 #define IMPLICIT_OCTREE_NNS_HASH_TABLE_TRAITS_HPP
 
+#include <cstddef>
+
 namespace implicit_octree_nns {
 /**
  * A collection of parameters and functions that must be specialized for a
@@ -22,6 +24,38 @@ struct hash_table_traits {
      * key exists, otherwise returns nullopt
      */
     static auto at(const hash_table_type& hash_table, const key_type& key);
+
+    // Optional members, only needed to insert or erase points of a nearest_neighbor (see
+    // nearest_neighbor::insert and nearest_neighbor::erase)
+
+    /**
+     * Inserts a key-value pair of {key, value} into the hash_table, replacing the value of key if
+     * it's already present
+     */
+    static auto insert_or_assign(hash_table_type& hash_table, const key_type& key,
+                                 const value_type& value);
+
+    /** Removes key and its value from the hash_table, if key is present */
+    static auto erase(hash_table_type& hash_table, const key_type& key);
+
+    // Optional members, only needed to save and load a nearest_neighbor (see
+    // nearest_neighbor::save), for hash tables storing their entries in one trivially copyable
+    // array
+
+    /** The element type of the array of entries */
+    using slot_type = typename hash_table_type::slot_type;
+
+    /** @return A pointer to the array of entries, and the number of elements in it */
+    static auto slots(const hash_table_type& hash_table);
+    static auto capacity(const hash_table_type& hash_table);
+
+    /** @return The number of key-value pairs in hash_table */
+    static auto size(const hash_table_type& hash_table);
+
+    /**
+     * @return A hash table using the given array of entries in place, which must outlive it
+     */
+    static auto view(const slot_type* slots, size_t capacity, size_t size);
 };
 }  // namespace implicit_octree_nns
 
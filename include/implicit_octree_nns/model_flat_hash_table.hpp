@@ -0,0 +1,260 @@
+#ifndef IMPLICIT_OCTREE_NNS_MODEL_FLAT_HASH_TABLE_HPP
+#define IMPLICIT_OCTREE_NNS_MODEL_FLAT_HASH_TABLE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "implicit_octree_nns/detail/buffer.hpp"
+#include "implicit_octree_nns/hash_table_traits.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+
+namespace implicit_octree_nns::model {
+
+/**
+ * An open-addressing hash table using linear probing, whose key-value pairs are stored inline in a
+ * single array of slots. Unlike the node-based model::hash_table, a lookup touches one contiguous
+ * run of slots instead of chasing a pointer per bucket entry
+ *
+ * The table can be sized once up front with reserve (or the sizing constructor); otherwise its
+ * capacity is doubled whenever an insertion would push the load factor above max_load_factor
+ *
+ * The slot array is trivially copyable for trivially copyable keys, so a table can also be a view
+ * of slots saved elsewhere (see view), eg. in a memory-mapped index file. Inserting into a view
+ * first copies its slots
+ *
+ * @tparam key_type_ The key type, must be default constructible and equality comparable
+ * @tparam hasher_ A hash functor for key_type_
+ */
+template <typename key_type_, typename hasher_>
+class basic_flat_hash_table {
+   public:
+    using key_type = key_type_;
+    using value_type = int;
+    using hasher = hasher_;
+
+    /** Lookups are linear in the probe length, so the table is kept at most half full */
+    static constexpr auto max_load_factor = 0.5;
+
+    struct slot_type {
+        key_type key{};
+        value_type value{};
+        bool occupied{false};
+    };
+
+    basic_flat_hash_table() = default;
+    explicit basic_flat_hash_table(size_t expected_size) { reserve(expected_size); }
+
+    /**
+     * @return A table that looks keys up in the given slots without copying them, which must stay
+     * alive as long as the table (and its copies) do
+     * @pre slots holds capacity slots previously taken from a table with size keys (see slots)
+     */
+    static auto view(const slot_type* slots, size_t capacity, size_t size) {
+        basic_flat_hash_table table;
+        table.slots_ = detail::buffer<slot_type>{slots, capacity};
+        table.size_ = size;
+        return table;
+    }
+
+    /**
+     * Ensures that expected_size keys can be inserted without the table having to grow
+     */
+    auto reserve(size_t expected_size) {
+        auto capacity = size_t{min_capacity};
+        while (!fits(expected_size, capacity)) {
+            capacity *= 2;
+        }
+        if (capacity > std::size(slots_)) {
+            rehash(capacity);
+        }
+    }
+
+    /**
+     * Inserts {key, value} into the table; if key is already present, its value is left unchanged
+     */
+    auto insert(const key_type& key, const value_type& value) {
+        if (!fits(size_ + 1, std::size(slots_))) {
+            reserve(size_ + 1);
+        }
+        auto index = probe(key);
+        if (!slots_[index].occupied) {
+            slots_.mutable_elements()[index] = {key, value, true};
+            slots_.elements_changed();
+            size_++;
+        }
+    }
+
+    /**
+     * Inserts {key, value} into the table, replacing the value of key if it's already present
+     */
+    auto insert_or_assign(const key_type& key, const value_type& value) {
+        if (!fits(size_ + 1, std::size(slots_))) {
+            reserve(size_ + 1);
+        }
+        auto index = probe(key);
+        size_ += slots_[index].occupied ? 0 : 1;
+        slots_.mutable_elements()[index] = {key, value, true};
+        slots_.elements_changed();
+    }
+
+    /**
+     * Removes key from the table if it's present. The following slots of its probe run are shifted
+     * back into the freed slot, so lookups never have to skip over deleted slots
+     */
+    auto erase(const key_type& key) {
+        if (std::empty(slots_) || !slots_[probe(key)].occupied) {
+            return;
+        }
+        auto& slots = slots_.mutable_elements();
+        auto mask = std::size(slots) - 1;
+        auto hole = probe(key);
+        for (auto next = (hole + 1) & mask; slots[next].occupied; next = (next + 1) & mask) {
+            // An entry can only move back to the hole if the hole is still within its probe run,
+            // ie. if it's at least as far from the entry's home slot as the entry itself
+            auto home = home_slot(slots[next].key);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        slots[hole] = slot_type{};
+        slots_.elements_changed();
+        size_--;
+    }
+
+    /**
+     * @return A pointer to the value corresponding to key if it exists, otherwise nullptr
+     */
+    auto find(const key_type& key) const -> const value_type* {
+        if (std::empty(slots_)) {
+            return nullptr;
+        }
+        const auto& slot = slots_[probe(key)];
+        return slot.occupied ? &slot.value : nullptr;
+    }
+
+    auto size() const { return size_; }
+    auto capacity() const { return std::size(slots_); }
+
+    /** @return The slot array, of capacity() slots */
+    auto slots() const { return slots_.data(); }
+
+    /** @return The number of bytes allocated for the slot array */
+    auto bytes_used() const { return slots_.bytes_used(); }
+
+   private:
+    static constexpr size_t min_capacity = 16;
+
+    static auto fits(size_t num_keys, size_t capacity) {
+        return static_cast<double>(num_keys) <= max_load_factor * static_cast<double>(capacity);
+    }
+
+    /**
+     * Finalizer from MurmurHash3, spreads the entropy of the hash over the low bits that are
+     * used to pick the initial slot
+     */
+    static auto mix(std::uint64_t hash_value) {
+        hash_value ^= hash_value >> 33u;
+        hash_value *= 0xff51afd7ed558ccdULL;
+        hash_value ^= hash_value >> 33u;
+        hash_value *= 0xc4ceb9fe1a85ec53ULL;
+        hash_value ^= hash_value >> 33u;
+        return hash_value;
+    }
+
+    /** @return The index of the first slot probed for key */
+    auto home_slot(const key_type& key) const {
+        return static_cast<size_t>(mix(hasher{}(key))) & (std::size(slots_) - 1);
+    }
+
+    /**
+     * @return The index of the slot holding key, or of the empty slot where key would be inserted
+     * @pre The table has at least one empty slot
+     */
+    auto probe(const key_type& key) const {
+        auto mask = std::size(slots_) - 1;
+        auto index = home_slot(key);
+        while (slots_[index].occupied && !(slots_[index].key == key)) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    auto rehash(size_t capacity) {
+        auto old_slots = detail::buffer<slot_type>{std::vector<slot_type>(capacity)};
+        old_slots.swap(slots_);
+        auto& slots = slots_.mutable_elements();
+        for (const auto& slot : old_slots) {
+            if (slot.occupied) {
+                slots[probe(slot.key)] = slot;
+            }
+        }
+    }
+
+    detail::buffer<slot_type> slots_{};
+    size_t size_{0};
+};
+
+/**
+ * The flat hash table keyed on (floored corner, depth) pairs, a drop-in replacement for
+ * model::hash_table
+ */
+template <typename point_type>
+using flat_hash_table = basic_flat_hash_table<std::pair<point_type, int>,
+                                              typename point_traits<point_type>::hasher>;
+
+/**
+ * The flat hash table keyed on packed 64-bit lattice cell keys (see detail::lattice). Using it with
+ * nearest_neighbor switches the data structure to integer lattice keys, which are cheaper to
+ * compute, hash and compare than (floored corner, depth) pairs
+ */
+template <typename point_type>
+using lattice_hash_table = basic_flat_hash_table<std::uint64_t, std::hash<std::uint64_t>>;
+
+}  // namespace implicit_octree_nns::model
+
+/**
+ * The specialization of the flat model hash table on the required traits
+ */
+template <typename key_type_, typename hasher_>
+struct implicit_octree_nns::hash_table_traits<
+    implicit_octree_nns::model::basic_flat_hash_table<key_type_, hasher_>> {
+    using hash_table_type = model::basic_flat_hash_table<key_type_, hasher_>;
+    using key_type = typename hash_table_type::key_type;
+    using value_type = typename hash_table_type::value_type;
+    using hasher = typename hash_table_type::hasher;
+    using slot_type = typename hash_table_type::slot_type;
+
+    static auto insert(hash_table_type& hash_table, const key_type& key, const value_type& value) {
+        hash_table.insert(key, value);
+    }
+
+    static auto insert_or_assign(hash_table_type& hash_table, const key_type& key,
+                                 const value_type& value) {
+        hash_table.insert_or_assign(key, value);
+    }
+
+    static auto erase(hash_table_type& hash_table, const key_type& key) { hash_table.erase(key); }
+
+    static auto at(const hash_table_type& hash_table, const key_type& key)
+        -> std::optional<value_type> {
+        if (const auto* value = hash_table.find(key)) {
+            return {*value};
+        } else {
+            return {};
+        }
+    }
+
+    static auto slots(const hash_table_type& hash_table) { return hash_table.slots(); }
+    static auto capacity(const hash_table_type& hash_table) { return hash_table.capacity(); }
+    static auto size(const hash_table_type& hash_table) { return hash_table.size(); }
+
+    static auto view(const slot_type* slots, size_t capacity, size_t size) {
+        return hash_table_type::view(slots, capacity, size);
+    }
+};
+
+#endif  // IMPLICIT_OCTREE_NNS_MODEL_FLAT_HASH_TABLE_HPP
@@ -2,6 +2,7 @@
 #define IMPLICIT_OCTREE_NNS_MODEL_HASH_TABLE_HPP
 
 #include <optional>
+#include <tuple>
 #include <unordered_map>
 
 #include "implicit_octree_nns/hash_table_traits.hpp"
@@ -15,6 +16,15 @@ struct hash_table {
     using value_type = int;
     using hasher = typename point_traits<point_type>::hasher;
     std::unordered_map<key_type, value_type, hasher> table;
+
+    /**
+     * @return An estimate of the number of bytes allocated by the table, counting the bucket array
+     * and one node (next pointer, cached hash and key-value pair) per entry
+     */
+    auto bytes_used() const {
+        using node_type = std::tuple<void*, std::pair<const key_type, value_type>, std::size_t>;
+        return table.bucket_count() * sizeof(void*) + table.size() * sizeof(node_type);
+    }
 };
 }  // namespace implicit_octree_nns::model
 
@@ -33,6 +43,15 @@ struct implicit_octree_nns::hash_table_traits<implicit_octree_nns::model::hash_t
         hash_table.table.insert({key, value});
     }
 
+    static auto insert_or_assign(hash_table_type& hash_table, const key_type& key,
+                                 const value_type& value) {
+        hash_table.table.insert_or_assign(key, value);
+    }
+
+    static auto erase(hash_table_type& hash_table, const key_type& key) {
+        hash_table.table.erase(key);
+    }
+
     static auto at(const hash_table_type& hash_table, const key_type& key)
         -> std::optional<value_type> {
         if (contains(hash_table, key)) {
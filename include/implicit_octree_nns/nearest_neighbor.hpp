@@ -1,11 +1,19 @@
 #ifndef IMPLICIT_OCTREE_NNS_NEAREST_NEIGHBOR_HPP
 #define IMPLICIT_OCTREE_NNS_NEAREST_NEIGHBOR_HPP
 
+#include <cstdint>
 #include <iterator>
+#include <optional>
+#include <string>
+#include <type_traits>
 #include <unordered_set>
 #include <vector>
 
+#include "implicit_octree_nns/build_stats.hpp"
+#include "implicit_octree_nns/detail/lattice.hpp"
+#include "implicit_octree_nns/detail/leaf_storage.hpp"
 #include "implicit_octree_nns/detail/octree_cell.hpp"
+#include "implicit_octree_nns/detail/serialization.hpp"
 #include "implicit_octree_nns/hash_table_traits.hpp"
 #include "implicit_octree_nns/model_hash_table.hpp"
 #include "implicit_octree_nns/point_traits.hpp"
@@ -13,11 +21,55 @@
 
 namespace implicit_octree_nns {
 
+template <typename nearest_neighbor_type_>
+class query_cursor;
+
 // Splitting condition
 struct splitting_condition {
     long double min_box_length{0};
     int max_depth{200};
     int max_points{20};
+    /**
+     * If positive, construction throws std::length_error once the leaves and the cells left to
+     * split hold more than this many copies of each point on average, checked after every depth.
+     * Points reach every child they may be the nearest neighbor in, which in 3D with few points per
+     * leaf, or points spread along a plane, can copy each point into hundreds of leaves
+     */
+    int max_copies_per_point{0};
+    /**
+     * Once a side of the extent of a cell's points is this many times longer than the cell, its
+     * points outside of the cell are also dropped from every child they can't be nearest to, as
+     * witnessed by the point nearest to the child's center. This keeps the small cells in the tail
+     * of a dense cluster from holding every point of the cluster, but costs a distance check per
+     * outside point and child; infinity never checks them, and 0 always does
+     */
+    double far_extent{detail::default_far_extent};
+};
+
+// Placement of the root bounding box
+struct root_box_policy {
+    /**
+     * If true, the root box is fitted to the extent of the initial point set along each axis, so
+     * that its center and side lengths follow the data rather than the origin; otherwise it's the
+     * cube centered on the origin that spans max_coordinate in every direction
+     */
+    bool fit_to_points{false};
+    /**
+     * The fraction of each side's length that a fitted root box is padded by on both ends, eg. to
+     * leave room for points inserted later (see detail::bounding_box::fitted)
+     */
+    double padding{0};
+};
+
+// Answering queries outside of the root bounding box
+enum class out_of_box_query {
+    /** The query has no answer */
+    reject,
+    /**
+     * The search starts from the boundary leaf closest to the query point, and the leaves around it
+     * are checked until none of them can hold a closer point, so the answer is exact
+     */
+    clamp
 };
 
 /**
@@ -31,7 +83,10 @@ struct splitting_condition {
  *
  * @tparam point_type_ The underlying point type; must specialize point_traits
  * @tparam hash_table_type_ The underlying hash table type; must specialize hash_table_traits. The
- * default type is std::unordered_type, and a specialization is already provided
+ * default type is std::unordered_type, and a specialization is already provided. If the key type
+ * of the hash table is std::uint64_t (eg. model::lattice_hash_table), octree cells are keyed by
+ * packed integer lattice keys (see detail::lattice) instead of (floored corner, depth) pairs, in
+ * which case the depth of the octree is capped at detail::lattice<point_type>::max_depth
  */
 template <typename point_type_, typename hash_table_type_ = model::hash_table<point_type_>>
 class nearest_neighbor {
@@ -54,6 +109,21 @@ class nearest_neighbor {
     using hash_table_type = hash_table_type_;
     using hash_table_key_type = typename hash_table_traits<hash_table_type>::key_type;
     using hash_table_value_type = typename hash_table_traits<hash_table_type>::value_type;
+    /** Whether octree cells are keyed by packed lattice keys rather than (corner, depth) pairs */
+    static constexpr auto uses_lattice_keys = std::is_integral_v<hash_table_key_type>;
+    static_assert(!uses_lattice_keys || std::is_same_v<hash_table_key_type, std::uint64_t>,
+                  "Lattice keys must be 64-bit unsigned integers");
+
+    /** Position of a point in the point set the data structure was initialized with */
+    using index_type = std::uint32_t;
+
+    /**
+     * @brief The nearest neighbor of a query, given by its index in the initial point set
+     */
+    struct neighbor {
+        index_type index;
+        coordinate_type distance_squared;
+    };
 
     // Constructors
 
@@ -65,63 +135,423 @@ class nearest_neighbor {
      * @param begin An iterator pointing to the start of a range corresponding to the initial point
      * set
      * @param end An iterator pointing to the end of a range corresponding to the initial point set
+     * @param num_threads The number of threads that split the cells of each depth in parallel; 0
+     * uses one thread per hardware thread. The resulting data structure is identical for any number
+     * of threads
+     * @param box_policy How the root bounding box is placed around the point set; max_coordinate
+     * is ignored if the box is fitted to the points. Data far from the origin or spread unevenly
+     * across axes wastes depths of the default cube centered on the origin, which a fitted box
+     * doesn't
      */
     template <typename ForwardIterator>
     nearest_neighbor(ForwardIterator begin, ForwardIterator end, coordinate_type max_coordinate = 0,
                      std::ostream& visualize_ostream = std::cout,
-                     splitting_condition condition = splitting_condition{});
+                     splitting_condition condition = splitting_condition{},
+                     unsigned num_threads = 1, root_box_policy box_policy = root_box_policy{});
 
     auto should_split(const detail::octree_cell<point_type>& cell,
-                      const splitting_condition& condition);
+                      const splitting_condition& condition) const;
 
     // Member functions
 
     /**
      * @returns The closest point to query_point out of the point set the data structure was
      * initialized with
+     *
+     * Queries only read the data structure, so any number of threads can query it concurrently
+     * (see query_executor). With visualization enabled, the output of each query is written to the
+     * visualization stream in one piece
      */
     auto find_nearest_neighbor(const point_type& query_point) const;
 
     /**
-     * Places the initial point set into a square bounding box centered on the origin
+     * Finds the nearest neighbor of every query point in [begin, end), writing them to out in the
+     * same order as the queries
+     *
+     * Queries are processed in blocks, and the depth binary search is run in lockstep for all
+     * queries of a block so that their hash table lookups are issued together
+     *
+     * @returns An iterator one past the last nearest neighbor written to out
+     */
+    template <typename ForwardIterator, typename OutputIterator>
+    auto find_nearest_neighbors(ForwardIterator begin, ForwardIterator end,
+                                OutputIterator out) const;
+
+    /**
+     * @returns The index of the closest point to query_point in the point set the data structure
+     * was initialized with, which lets callers map the result to their own records directly
+     */
+    auto find_nearest_neighbor_index(const point_type& query_point) const -> index_type;
+
+    /**
+     * Same as find_nearest_neighbor_index, but also returns the squared distance between
+     * query_point and its nearest neighbor
+     */
+    auto find_nearest_neighbor_with_distance(const point_type& query_point) const -> neighbor;
+
+    /**
+     * Same as find_nearest_neighbor_with_distance, but never throws: a query point outside of the
+     * root bounding box is either rejected or answered from the boundary leaves (see
+     * out_of_box_query). Queries inside of the box take the same path as the throwing queries and
+     * allocate nothing; clamped queries allocate their search queue
+     *
+     * @returns The nearest neighbor of query_point, or nothing if the query is rejected or if a
+     * clamped query can't allocate its search queue
+     */
+    auto try_find_nearest_neighbor(const point_type& query_point,
+                                   out_of_box_query mode = out_of_box_query::reject) const noexcept
+        -> std::optional<neighbor>;
+
+    /**
+     * Same as find_nearest_neighbors, but writes the index of each nearest neighbor (see
+     * find_nearest_neighbor_index) instead of a copy of it
+     */
+    template <typename ForwardIterator, typename OutputIterator>
+    auto find_nearest_neighbor_indices(ForwardIterator begin, ForwardIterator end,
+                                       OutputIterator out) const;
+
+    /**
+     * @returns The min(k, number of points) closest points to query_point, sorted by increasing
+     * distance
+     *
+     * The search starts at the leaf found by the depth binary search and expands into the leaves
+     * around it, found by looking up the neighboring cells of each visited leaf at its depth (or
+     * at the depths of their ancestors or descendants). Leaves are visited closest to query_point
+     * first, and the search stops once the next leaf is farther away than the k-th closest point
+     * found so far
+     */
+    auto find_k_nearest(const point_type& query_point, size_t k) const -> std::vector<neighbor>;
+
+    /**
+     * Calls callback(neighbor) once for every point whose distance to query_point is at most
+     * radius, in no particular order
+     *
+     * The lattice cells overlapping the bounding box of the query ball are enumerated at the
+     * deepest depth whose cells are still as long as the diameter of the ball, and each of them is
+     * resolved to the leaves covering it through the hash table. A point held by several leaves is
+     * only reported by the leaf containing it, so no point is reported twice
+     */
+    template <typename Callback>
+    auto for_each_within_radius(const point_type& query_point, coordinate_type radius,
+                                Callback callback) const -> void;
+
+    /**
+     * @returns The number of points whose distance to query_point is at most radius (see
+     * for_each_within_radius)
+     */
+    auto count_within_radius(const point_type& query_point, coordinate_type radius) const
+        -> size_t;
+
+    /**
+     * Inserts new_point into the data structure without rebuilding it. Only the leaves whose boxes
+     * the Voronoi cell of new_point reaches are updated, and any of them that then has to be split
+     * according to the splitting condition is split the same way the constructor splits cells
+     *
+     * Insertions modify the data structure, so they must not run concurrently with queries or
+     * other insertions
+     *
+     * @pre new_point isn't in the point set yet
+     * @throws std::invalid_argument If new_point is outside of the root bounding box, which is
+     * fixed when the data structure is constructed
+     * @returns The index of new_point in the point set (see find_nearest_neighbor_index)
+     */
+    auto insert(const point_type& new_point) -> index_type;
+
+    /**
+     * Erases the point with the given index from the data structure without rebuilding it. The
+     * point is removed from the leaves whose boxes its Voronoi cell reaches, and the points whose
+     * Voronoi cells grow into those leaves once it's gone are added to them. The point keeps its
+     * index, marked by a tombstone, so the indices of the other points never change
+     *
+     * Leaves are merged lazily: only the parents of the leaves repaired by an erasure are checked,
+     * and their children are merged back into them if together they hold few enough points that
+     * the splitting condition wouldn't split the parent
+     *
+     * Erasures modify the data structure, so they must not run concurrently with queries, other
+     * erasures or insertions
+     *
+     * @throws std::invalid_argument If there's no point with the given index, if it was already
+     * erased, or if it's the last point of the data structure
+     */
+    auto erase(index_type index) -> void;
+
+    /**
+     * Same as erase(index_type), but erases the point equal to erased_point
+     *
+     * @throws std::invalid_argument If erased_point isn't in the data structure
+     * @returns The index of the erased point
+     */
+    auto erase(const point_type& erased_point) -> index_type;
+
+    /**
+     * @returns The point with the given index in the point set, including inserted and erased
+     * points
+     */
+    const auto& point(index_type index) const { return leaf_points_.point(index); }
+
+    /**
+     * Places the initial point set into a square bounding box centered on the origin, or into a
+     * box fitted to it (see root_box_policy)
      */
     template <typename ForwardIterator>
     auto initialize_bounding_box(ForwardIterator begin, ForwardIterator end,
-                                 coordinate_type max_coord);
+                                 coordinate_type max_coord,
+                                 root_box_policy box_policy = root_box_policy{});
 
     /**
      * Splits octree cells that contain too many points into children cells, each child cell
      * contains all points that are the nearest neighbor to some point in the cell, which means that
      * a single point might be part of multiple child cells
+     *
+     * The cells are split by num_threads_ threads, each working on a contiguous range of cells with
+     * its own buffer of children. The leaves, hash table entries and children are then merged in
+     * the order of the cells, so the result doesn't depend on the number of threads
+     *
+     * @returns The statistics of the depth, except for its elapsed time
      */
-    auto split_saturated_cells(int depth);
+    auto split_saturated_cells(int depth) -> build_stats::depth_stats;
+
+    /**
+     * @return Whether some of the children of cell hold fewer points than cell. If every child
+     * holds all of them, e.g. for points on a sphere around the cell, splitting again would only
+     * copy the points into ever smaller cells, so the cell is kept as a leaf even though it's
+     * saturated
+     */
+    static auto separates_points(
+        const detail::octree_cell<point_type>& cell,
+        const std::array<detail::octree_cell<point_type>, (1u << dimension)>& children) -> bool;
 
     /** The number of points used to construct this data structure */
     auto construction_set_size() const;
 
-    /** The number of octree cells in the data structure */
+    /** The number of octree leaves in the data structure */
     auto size() const;
 
     /** The maximum depth for any octree cell in the data structure */
     auto depth() const;
 
+    /**
+     * Copies the hash entries of the shallowest depths into dense arrays indexed by lattice key,
+     * which queries read instead of the hash table. The shallow depths of the octree are close to
+     * fully populated, so the arrays waste little space, and reading them involves no hashing or
+     * probing. Insertions and erasures keep the arrays up to date
+     *
+     * Every depth d needs 2^(d * dimension) entries; the arrays cover depths 0 up to the deepest
+     * depth whose arrays fit in max_bytes together with those of the shallower depths, and a
+     * max_bytes of 0 removes them
+     *
+     * @pre Octree cells are keyed by lattice keys (see uses_lattice_keys)
+     * @returns The deepest depth covered by the arrays, or -1 if there are none
+     */
+    auto use_dense_levels(size_t max_bytes = size_t{1} << 22u) -> int;
+
+    /** The deepest depth whose hash entries are read from dense arrays, or -1 if there are none */
+    auto dense_depth() const { return dense_depth_; }
+
+    /** The hash table mapping every octree cell to its leaf index, or -1 for internal cells */
+    const auto& octree_hash_table() const { return implicit_octree_; }
+
+    /** The number of bytes allocated for the leaves, including the initial point set */
+    auto leaf_bytes_used() const { return leaf_points_.bytes_used(); }
+
+    /**
+     * The per-depth cell counts and stage timings recorded by the constructor, eg. to find the
+     * depth or stage that dominates the construction time; empty for loaded data structures
+     */
+    const auto& build_statistics() const { return build_stats_; }
+
+    /**
+     * The first stage of a nearest neighbor query on its own, eg. to time the depth search of
+     * queries separately from the scans of their leaves (see splitting_tuner)
+     *
+     * @param num_probes If not null, incremented by the number of hash table lookups of the search
+     * @returns The index of the leaf containing query_point, or -1 if query_point is outside of the
+     * root bounding box
+     */
+    auto find_leaf_index(const point_type& query_point, size_t* num_probes = nullptr) const
+        -> int;
+
+    /**
+     * The second stage of a nearest neighbor query on its own: the point of the given leaf nearest
+     * to query_point (see find_leaf_index)
+     */
+    auto find_nearest_in_leaf(int leaf, const point_type& query_point) const -> neighbor;
+
+    /** The number of points stored in the given leaf, which a query of the leaf scans */
+    auto leaf_size(int leaf) const { return leaf_points_.size(static_cast<size_t>(leaf)); }
+
+    // Serialization
+
+    /**
+     * Saves the data structure to the file at path, so it can be restored by load or open_mapped
+     * without being rebuilt. Every array is written as it's laid out in memory (see
+     * detail::serialization), so the file can only be opened with the same point and hash table
+     * types; only hash tables that expose their array of entries (eg. model::flat_hash_table and
+     * model::lattice_hash_table) can be saved
+     *
+     * @throws std::runtime_error If the file can't be written
+     */
+    auto save(const std::string& path) const -> void;
+
+    /**
+     * @returns The data structure saved to the file at path, which is read into memory once. The
+     * data structure uses the read arrays in place, so loading never processes individual points
+     *
+     * @throws std::runtime_error If the file can't be read, isn't a saved data structure or was
+     * saved with different point or hash table types
+     */
+    static auto load(const std::string& path, std::ostream& visualize_ostream = std::cout)
+        -> nearest_neighbor;
+
+    /**
+     * Same as load, but maps the file into memory instead of reading it, so only the pages touched
+     * by queries are ever read from disk and the pages are shared by all processes mapping the
+     * same file. The file must not be modified while the data structure or its copies are alive
+     */
+    static auto open_mapped(const std::string& path, std::ostream& visualize_ostream = std::cout)
+        -> nearest_neighbor;
+
    private:
+    template <typename nearest_neighbor_type_>
+    friend class query_cursor;
+
+    /** The number of queries whose depth searches are run in lockstep by find_nearest_neighbors */
+    static constexpr size_t batch_block_size = 64;
+
     // Octree cell typedefs
     using octree_cell_type = detail::octree_cell<point_type>;
+    using leaf_storage_type = detail::leaf_storage<point_type>;
+    using lattice_type = detail::lattice<point_type>;
+    /** What a query point is reduced to before computing its key at each depth */
+    using key_source_type =
+        std::conditional_t<uses_lattice_keys, typename lattice_type::coordinates_type, point_type>;
+
+    /**
+     * @returns The index of the leaf containing query_point, found by binary searching its depth
+     * @param leaf_depth If not null, receives the depth of the leaf
+     * @pre query_point is inside the root bounding box
+     */
+    auto locate_leaf(const point_type& query_point, const visualize::geometry_drawer& drawer,
+                     int* leaf_depth = nullptr) const -> int;
+
+    /**
+     * Calls callback(query_point, leaf_index) with the leaf containing every query point in
+     * [begin, end), in order
+     *
+     * Queries are processed in blocks, and the depth binary search is run in lockstep for all
+     * queries of a block so that their hash table lookups are issued together
+     */
+    template <typename ForwardIterator, typename Callback>
+    auto locate_leaves(ForwardIterator begin, ForwardIterator end, Callback callback) const;
+
+    /**
+     * Same as locate_leaf, but the depth search first probes hint_depth, then the depth next to it
+     * in the direction of the leaf, before falling back to binary searching the remaining depths.
+     * Any hint gives the same leaf, but a hint within one depth of the leaf's takes at most two
+     * hash table lookups
+     *
+     * @param leaf_depth Receives the depth of the leaf
+     * @param num_probes Incremented by the number of hash table lookups
+     */
+    auto locate_leaf_from(const key_source_type& source, int hint_depth, int& leaf_depth,
+                          size_t& num_probes) const -> int;
+
+    /**
+     * Finds the leaves whose boxes the Voronoi cell of target reaches, by searching the octree from
+     * the root outwards from target and pruning every cell that a point of the leaves seen so far
+     * is closer to everywhere. Erased points never prune cells
+     *
+     * @param seen Receives the points of every visited leaf that haven't been erased, possibly
+     * repeatedly
+     * @returns The leaf index of each reached leaf, and a cell with its box and its points that
+     * haven't been erased
+     */
+    auto find_reached_leaves(const point_type& target, std::vector<index_type>& seen) const
+        -> std::vector<std::pair<int, octree_cell_type>>;
+
+    /**
+     * Replaces the points of the given leaf by those of cell, after splitting cell (and its
+     * children) as long as should_split says so; the first leaf split from cell reuses the index
+     * of the replaced leaf
+     */
+    auto replace_leaf(int leaf, octree_cell_type cell) -> void;
+
+    /**
+     * Merges the children of the parent of cell into the parent if all of them are leaves and the
+     * parent holding all of their points wouldn't be split, then repeats for the merged parent
+     */
+    auto merge_leaves_upwards(octree_cell_type cell) -> void;
+
+    /** @returns The index of a leaf freed by merge_leaves_upwards, or a new leaf index */
+    auto allocate_leaf() -> int;
+
+    /** @returns The leaf index of query_point, or throws if it's outside of the root box */
+    auto checked_locate_leaf(const point_type& query_point, int* leaf_depth = nullptr) const
+        -> int;
+
+    /**
+     * Same as checked_locate_leaf, for query points already known to be inside of the root box
+     * @pre query_point is inside the root bounding box
+     */
+    auto locate_contained_leaf(const point_type& query_point, int* leaf_depth = nullptr) const
+        -> int;
+
+    /**
+     * @returns The min(k, number of points) closest points to query_point, sorted by increasing
+     * distance, found by searching the leaves outwards from the leaf at start_depth containing
+     * start (see find_k_nearest). start is the closest position to query_point in the root box
+     */
+    auto find_k_nearest_from(const point_type& query_point, const point_type& start,
+                             int start_depth, size_t k) const -> std::vector<neighbor>;
+
+    /**
+     * @returns The hash entry of the cell with the given key at the given depth, read from the
+     * dense arrays if they cover the depth (see use_dense_levels)
+     */
+    auto cell_entry(const hash_table_key_type& key, int depth) const
+        -> std::optional<hash_table_value_type>;
+    /** Sets the hash entry of a cell, in the hash table and the dense arrays */
+    auto assign_cell_entry(const hash_table_key_type& key, int depth, hash_table_value_type value)
+        -> void;
+    /** Erases the hash entry of a cell, from the hash table and the dense arrays */
+    auto erase_cell_entry(const hash_table_key_type& key, int depth) -> void;
+    /** @returns The position of the cell with the given lattice key in the dense arrays */
+    static auto dense_slot(std::uint64_t key, int depth) -> size_t;
+
+    auto key_source(const point_type& point) const -> key_source_type;
+    auto make_key(const key_source_type& source, int depth) const -> hash_table_key_type;
+    auto cell_key(const octree_cell_type& cell, int depth) const -> hash_table_key_type;
+
+    /** The file header describing the saved types of this data structure */
+    static auto layout_header() -> detail::serialization::file_header;
+    static auto open_file(const std::string& path, bool map, std::ostream& visualize_ostream)
+        -> nearest_neighbor;
 
     // Data members
     std::vector<octree_cell_type> octree_cells_;
+    /** The leaves of the octree, only kept during construction until leaf_points_ takes them */
     std::vector<octree_cell_type> octree_leaves_;
+    leaf_storage_type leaf_points_;
+    /** Leaf indices that no cell uses since their cells were merged into their parents */
+    std::vector<int> free_leaves_;
     hash_table_type implicit_octree_{};
+    /** The hash entries of depths 0 to dense_depth_, one level after another in Morton order */
+    std::vector<hash_table_value_type> dense_levels_;
+    int dense_depth_{-1};
+    /** Marks cells of the dense arrays that don't exist in the octree */
+    static constexpr hash_table_value_type dense_absent = -2;
     octree_cell_type root_cell_;
+    lattice_type lattice_;
     int max_depth_used_;
     size_t construction_set_size_;
+    unsigned num_threads_{1};
     visualize::geometry_drawer drawer_;
     /**
      * The variable that determines when an octree cell can/must be split further
      * Based on minimum cell length, max cell depth, and the max number of points in a cell
      */
     splitting_condition condition_{};
+    build_stats build_stats_{};
 };
 
 // Constructor template deduction guides
@@ -0,0 +1,101 @@
+#ifndef IMPLICIT_OCTREE_NNS_QUERY_CURSOR_HPP
+#define IMPLICIT_OCTREE_NNS_QUERY_CURSOR_HPP
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace implicit_octree_nns {
+
+/**
+ * @brief Answers a stream of spatially coherent nearest neighbor queries, eg. the positions along a
+ * trajectory, by remembering the leaf of the previous query
+ *
+ * A query whose key at the depth of the remembered leaf is the leaf's key (ie. that's inside the
+ * leaf's box) is answered by the remembered leaf without any hash table lookups. Any other query
+ * starts the depth search at the depth of the remembered leaf, which usually takes one or two
+ * lookups for a query in a neighboring leaf, instead of binary searching every depth
+ *
+ * A cursor only reads the data structure, which must outlive it, but isn't thread-safe itself, so
+ * each thread needs its own cursor. Inserting or erasing points invalidates the remembered leaf,
+ * so call reset before querying again
+ *
+ * @tparam nearest_neighbor_type_ The type of the queried data structure, eg. nearest_neighbor
+ */
+template <typename nearest_neighbor_type_>
+class query_cursor {
+   public:
+    using nearest_neighbor_type = nearest_neighbor_type_;
+    using point_type = typename nearest_neighbor_type::point_type;
+    using index_type = typename nearest_neighbor_type::index_type;
+    using neighbor = typename nearest_neighbor_type::neighbor;
+
+    explicit query_cursor(const nearest_neighbor_type& locator) : locator_{locator} {}
+
+    /**
+     * Same as nearest_neighbor::find_nearest_neighbor_with_distance
+     *
+     * @throws std::invalid_argument If query_point is outside of the root bounding box
+     */
+    auto find_nearest_neighbor_with_distance(const point_type& query_point) -> neighbor {
+        if (!locator_.root_cell_.box.contains(query_point)) {
+            throw std::invalid_argument(
+                "Query point outside bounding box of construction point set");
+        }
+        num_queries_++;
+        auto source = locator_.key_source(query_point);
+        if (leaf_ != -1 && locator_.make_key(source, leaf_depth_) == leaf_key_) {
+            num_hits_++;
+        } else {
+            leaf_ = locator_.locate_leaf_from(source, leaf_depth_, leaf_depth_, num_probes_);
+            leaf_key_ = locator_.make_key(source, leaf_depth_);
+        }
+        auto closest = locator_.leaf_points_.closest(leaf_, query_point);
+        return {static_cast<index_type>(closest.index), closest.distance_squared};
+    }
+
+    /** Same as nearest_neighbor::find_nearest_neighbor_index */
+    auto find_nearest_neighbor_index(const point_type& query_point) -> index_type {
+        return find_nearest_neighbor_with_distance(query_point).index;
+    }
+
+    /** Same as nearest_neighbor::find_nearest_neighbor */
+    auto find_nearest_neighbor(const point_type& query_point) {
+        return locator_.point(find_nearest_neighbor_index(query_point));
+    }
+
+    /** Forgets the remembered leaf, so the next query binary searches every depth */
+    auto reset() -> void {
+        leaf_ = -1;
+        leaf_depth_ = -1;
+    }
+
+    /** The number of queries answered by this cursor */
+    auto num_queries() const { return num_queries_; }
+
+    /** The number of queries answered by the remembered leaf, without any hash table lookups */
+    auto num_hits() const { return num_hits_; }
+
+    /** The number of hash table lookups made by the depth searches of this cursor */
+    auto num_probes() const { return num_probes_; }
+
+    /** The fraction of queries answered by the remembered leaf, or 0 before the first query */
+    auto hit_rate() const {
+        if (num_queries_ == 0) return 0.;
+        return static_cast<double>(num_hits_) / static_cast<double>(num_queries_);
+    }
+
+   private:
+    using hash_table_key_type = typename nearest_neighbor_type::hash_table_key_type;
+
+    const nearest_neighbor_type& locator_;
+    int leaf_{-1};
+    int leaf_depth_{-1};
+    hash_table_key_type leaf_key_{};
+    size_t num_queries_{0};
+    size_t num_hits_{0};
+    size_t num_probes_{0};
+};
+
+}  // namespace implicit_octree_nns
+
+#endif  // IMPLICIT_OCTREE_NNS_QUERY_CURSOR_HPP
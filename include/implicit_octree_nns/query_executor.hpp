@@ -0,0 +1,79 @@
+#ifndef IMPLICIT_OCTREE_NNS_QUERY_EXECUTOR_HPP
+#define IMPLICIT_OCTREE_NNS_QUERY_EXECUTOR_HPP
+
+#include <iterator>
+
+#include "implicit_octree_nns/detail/parallel.hpp"
+
+namespace implicit_octree_nns {
+
+/**
+ * @brief Answers batches of nearest neighbor queries on a fixed pool of worker threads
+ *
+ * All of the workers query the same data structure, which must outlive the executor. Each batch is
+ * split into one contiguous range of queries per worker, and every worker runs the batched
+ * find_nearest_neighbors on its own range
+ *
+ * @tparam nearest_neighbor_type_ The type of the queried data structure, eg. nearest_neighbor
+ */
+template <typename nearest_neighbor_type_>
+class query_executor {
+   public:
+    using nearest_neighbor_type = nearest_neighbor_type_;
+
+    /**
+     * @param num_threads The number of threads answering queries, including the thread that calls
+     * find_nearest_neighbors; 0 uses one thread per hardware thread
+     */
+    explicit query_executor(const nearest_neighbor_type& locator, unsigned num_threads = 0)
+        : locator_{locator}, pool_{num_threads} {}
+
+    /**
+     * Finds the nearest neighbor of every query point in [begin, end), writing them to the output
+     * range starting at out in the same order as the queries
+     *
+     * If a query throws (eg. it's outside of the bounding box), the exception is rethrown once all
+     * threads finish; the contents of the output range are then unspecified
+     *
+     * @returns An iterator one past the last nearest neighbor written to out
+     */
+    template <typename RandomAccessIterator, typename RandomAccessOutputIterator>
+    auto find_nearest_neighbors(RandomAccessIterator begin, RandomAccessIterator end,
+                                RandomAccessOutputIterator out) {
+        using difference_type =
+            typename std::iterator_traits<RandomAccessIterator>::difference_type;
+        using out_difference_type =
+            typename std::iterator_traits<RandomAccessOutputIterator>::difference_type;
+        auto num_queries = static_cast<size_t>(std::distance(begin, end));
+        pool_.for_each_chunk(num_queries, [&](size_t, size_t chunk_begin, size_t chunk_end) {
+            locator_.find_nearest_neighbors(
+                std::next(begin, static_cast<difference_type>(chunk_begin)),
+                std::next(begin, static_cast<difference_type>(chunk_end)),
+                std::next(out, static_cast<out_difference_type>(chunk_begin)));
+        });
+        return std::next(out, static_cast<out_difference_type>(num_queries));
+    }
+
+    /** The number of threads answering queries */
+    auto num_threads() const { return pool_.size(); }
+
+   private:
+    const nearest_neighbor_type& locator_;
+    detail::thread_pool pool_;
+};
+
+/**
+ * Convenience wrapper that answers a single batch of queries with a temporary query_executor
+ */
+template <typename nearest_neighbor_type, typename RandomAccessIterator,
+          typename RandomAccessOutputIterator>
+auto parallel_find_nearest_neighbors(const nearest_neighbor_type& locator,
+                                     RandomAccessIterator begin, RandomAccessIterator end,
+                                     RandomAccessOutputIterator out, unsigned num_threads = 0) {
+    auto executor = query_executor<nearest_neighbor_type>{locator, num_threads};
+    return executor.find_nearest_neighbors(begin, end, out);
+}
+
+}  // namespace implicit_octree_nns
+
+#endif  // IMPLICIT_OCTREE_NNS_QUERY_EXECUTOR_HPP
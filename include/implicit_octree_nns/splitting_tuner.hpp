@@ -0,0 +1,354 @@
+#ifndef IMPLICIT_OCTREE_NNS_SPLITTING_TUNER_HPP
+#define IMPLICIT_OCTREE_NNS_SPLITTING_TUNER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+
+namespace implicit_octree_nns {
+
+/** The options of splitting_tuner::tune */
+struct tuning_options {
+    /**
+     * The number of points the candidate octrees are built on, sampled from the input without
+     * replacement; the whole input is used if it isn't larger
+     */
+    size_t sample_size{size_t{1} << 16u};
+    /** The number of query points timed on each candidate octree, sampled from the input */
+    size_t num_queries{4096};
+    /** The number of times the queries are timed, of which the fastest time is kept */
+    int num_repeats{3};
+    /**
+     * The values of splitting_condition::max_points that are tried. If empty, the values from 8 in
+     * 2D or 16 in 3D up to 200 are tried: with fewer points per leaf, the cells around points where
+     * many Voronoi cells meet are split until each point is copied into over a hundred leaves in 3D
+     */
+    std::vector<int> candidate_max_points{};
+    /**
+     * Candidates predicted to take more bytes than this are only picked if every candidate does,
+     * in which case the one predicted to take the fewest bytes is picked; 0 means no limit
+     */
+    size_t max_bytes{0};
+    /** The seed of the samples of points and queries */
+    std::uint32_t seed{0};
+    /** Forwarded to the constructor of the candidate octrees (see nearest_neighbor) */
+    unsigned num_threads{1};
+    root_box_policy box_policy{};
+};
+
+/**
+ * @brief The measured and predicted costs of one candidate splitting condition of
+ * splitting_tuner::tune
+ *
+ * Times are in nanoseconds. The measured costs are those of the octree of the sample, and the
+ * predicted costs are extrapolated to the octree of the whole input
+ */
+struct splitting_candidate {
+    splitting_condition condition{};
+    /** The number of queries timed, which are those inside of the root box of the sample */
+    size_t num_queries{0};
+    /** The average number of hash table lookups of the depth search of a query */
+    double probes_per_query{0};
+    /** The average time of one hash table lookup of the depth search */
+    double probe_time{0};
+    /** The average number of points scanned in the leaf of a query */
+    double points_per_query{0};
+    /** The average time of scanning the leaf of a query */
+    double scan_time{0};
+    /** The number of cells (internal cells and leaves) of the octree of the sample */
+    size_t num_cells{0};
+    /** The depth of the octree of the sample (see nearest_neighbor::depth) */
+    int depth{0};
+    /** The bytes of the leaves of the octree of the sample (see leaf_bytes_used) */
+    size_t leaf_bytes{0};
+
+    /** Infinite if no query was timed, since nothing is known about the time of queries then */
+    double predicted_query_time{0};
+    /** The bytes of the leaves and of the hash table entries, without unused hash table slots */
+    size_t predicted_bytes{0};
+};
+
+/** The splitting condition picked by splitting_tuner::tune, and the costs of every candidate */
+struct tuned_splitting_condition {
+    splitting_condition condition{};
+    /**
+     * The predicted average time of a nearest neighbor query, in nanoseconds; infinite if no query
+     * was timed (see splitting_candidate::num_queries)
+     */
+    double predicted_query_time{0};
+    /** The predicted bytes of the leaves and of the hash table entries (see splitting_candidate) */
+    size_t predicted_bytes{0};
+    std::vector<splitting_candidate> candidates{};
+};
+
+/**
+ * @brief Picks the splitting condition of a nearest_neighbor that minimizes the time of its
+ * queries on a given input, from a cost model measured on this machine
+ *
+ * A query costs the hash table lookups of its depth search plus the scan of its leaf. Larger leaves
+ * take longer to scan, but make the octree shallower and its hash table smaller, so that lookups
+ * are fewer and more likely to hit the cache. How these trade off depends on the distribution of
+ * the points and on the machine, so every candidate max_points is built on a sample of the input
+ * and its queries are timed, separately for the depth searches and the leaf scans
+ *
+ * The costs measured on the sample are then extrapolated to the whole input: an octree of scale
+ * times as many points has scale times as many cells and bytes of leaves, its leaves hold as many
+ * points, and it's log2(scale) / dimension levels deeper, which adds log2 of the relative growth of
+ * its depth to the lookups of the binary searched depth. Its hash table and leaves are also scale
+ * times larger, so they're less likely to be cached, which is accounted for by the latencies of
+ * random reads from memory of their sizes, measured on this machine
+ *
+ * The depth limits of the splitting condition (min_box_length and max_depth) are left at their
+ * defaults, since they only guard against degenerate inputs
+ *
+ * @tparam nearest_neighbor_type_ The type of the tuned data structure, eg. nearest_neighbor
+ */
+template <typename nearest_neighbor_type_>
+class splitting_tuner {
+   public:
+    using nearest_neighbor_type = nearest_neighbor_type_;
+    using point_type = typename nearest_neighbor_type::point_type;
+    static constexpr auto dimension = nearest_neighbor_type::dimension;
+
+    /**
+     * @returns The candidate splitting condition predicted to answer queries on the points in
+     * [begin, end) the fastest, with the predicted costs of every candidate
+     * @pre [begin, end) isn't empty and holds no duplicate points
+     */
+    template <typename ForwardIterator>
+    static auto tune(ForwardIterator begin, ForwardIterator end,
+                     const tuning_options& options = tuning_options{})
+        -> tuned_splitting_condition {
+        auto generator = std::mt19937{options.seed};
+        auto num_points = static_cast<size_t>(std::distance(begin, end));
+        std::vector<point_type> sample;
+        std::sample(begin, end, std::back_inserter(sample), options.sample_size, generator);
+        std::vector<point_type> queries;
+        std::sample(begin, end, std::back_inserter(queries), options.num_queries, generator);
+        auto scale = static_cast<double>(num_points) / static_cast<double>(std::size(sample));
+
+        auto candidate_max_points = options.candidate_max_points;
+        if (std::empty(candidate_max_points)) {
+            for (auto max_points : {8, 12, 16, 24, 32, 48, 64, 96, 128, 200}) {
+                if (dimension == 2 || max_points >= 16) candidate_max_points.push_back(max_points);
+            }
+        }
+        tuned_splitting_condition result{};
+        for (auto max_points : candidate_max_points) {
+            auto condition = splitting_condition{};
+            condition.max_points = max_points;
+            result.candidates.push_back(measure(sample, queries, condition, options));
+        }
+        using hash_table_key_type = typename nearest_neighbor_type::hash_table_key_type;
+        using hash_table_value_type = typename nearest_neighbor_type::hash_table_value_type;
+        // Hash tables leave slots free or allocate nodes for their entries, which takes about as
+        // many bytes again as the entries themselves
+        constexpr auto entry_bytes =
+            2 * (sizeof(hash_table_key_type) + sizeof(hash_table_value_type));
+        read_latencies latencies{};
+        for (auto& candidate : result.candidates) {
+            auto depth = static_cast<double>(candidate.depth);
+            auto predicted_depth = depth + std::log2(scale) / dimension;
+            auto extra_probes = std::log2((predicted_depth + 1) / (depth + 1));
+            auto probes = candidate.probes_per_query + extra_probes;
+            // The hash table and the leaves of the sample mostly stay cached while its queries are
+            // timed, unlike those of the whole input, so the latency of a read from memory of the
+            // size of the sample's is swapped for that of the whole input's for every read of a
+            // lookup or of a leaf scan
+            auto table_bytes = static_cast<double>(candidate.num_cells * entry_bytes);
+            auto leaf_bytes = static_cast<double>(candidate.leaf_bytes);
+            auto probe_time = candidate.probe_time +
+                              latencies.extra_latency(table_bytes, table_bytes * scale, generator);
+            auto scan_time =
+                candidate.scan_time +
+                reads_per_scan * latencies.extra_latency(leaf_bytes, leaf_bytes * scale, generator);
+            candidate.predicted_query_time = candidate.num_queries == 0
+                                                 ? std::numeric_limits<double>::infinity()
+                                                 : probes * probe_time + scan_time;
+            candidate.predicted_bytes = static_cast<size_t>((table_bytes + leaf_bytes) * scale);
+        }
+
+        auto fits = [&](const splitting_candidate& candidate) {
+            return options.max_bytes == 0 || candidate.predicted_bytes <= options.max_bytes;
+        };
+        auto faster = [&](const splitting_candidate& a, const splitting_candidate& b) {
+            if (fits(a) != fits(b)) return fits(a);
+            if (!fits(a)) return a.predicted_bytes < b.predicted_bytes;
+            return a.predicted_query_time < b.predicted_query_time;
+        };
+        const auto& best =
+            *std::min_element(std::begin(result.candidates), std::end(result.candidates), faster);
+        result.condition = best.condition;
+        result.predicted_query_time = best.predicted_query_time;
+        result.predicted_bytes = best.predicted_bytes;
+        return result;
+    }
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * The range of a leaf, its coordinates and the index of its closest point are read from
+     * separate arrays when it's scanned
+     */
+    static constexpr auto reads_per_scan = 3;
+
+    /** @returns The costs of condition measured on the octree of sample, without predictions */
+    static auto measure(const std::vector<point_type>& sample,
+                        const std::vector<point_type>& queries,
+                        const splitting_condition& condition, const tuning_options& options)
+        -> splitting_candidate {
+        // The visualization output of a candidate octree is of no use
+        std::ostringstream discarded;
+        auto locator =
+            nearest_neighbor_type(std::begin(sample), std::end(sample), 0, discarded, condition,
+                                  options.num_threads, options.box_policy);
+        splitting_candidate candidate{};
+        candidate.condition = condition;
+        for (const auto& depth : locator.build_statistics().depths) {
+            candidate.num_cells += depth.cells_processed;
+        }
+        candidate.depth = locator.depth();
+        candidate.leaf_bytes = locator.leaf_bytes_used();
+
+        std::vector<point_type> contained;
+        for (const auto& query_point : queries) {
+            if (locator.find_leaf_index(query_point) != -1) contained.push_back(query_point);
+        }
+        std::vector<int> leaves(std::size(contained));
+        size_t num_probes = 0;
+        size_t num_scanned = 0;
+        auto locate_time = std::numeric_limits<double>::max();
+        auto scan_time = std::numeric_limits<double>::max();
+        // Keeps the scans from being optimized out
+        double distance_sum = 0;
+        for (int repeat = 0; repeat < std::max(options.num_repeats, 1); repeat++) {
+            num_probes = 0;
+            auto start = clock::now();
+            for (size_t it = 0; it < std::size(contained); it++) {
+                leaves[it] = locator.find_leaf_index(contained[it], &num_probes);
+            }
+            auto located = clock::now();
+            num_scanned = 0;
+            for (size_t it = 0; it < std::size(contained); it++) {
+                auto closest = locator.find_nearest_in_leaf(leaves[it], contained[it]);
+                distance_sum += static_cast<double>(closest.distance_squared);
+                num_scanned += locator.leaf_size(leaves[it]);
+            }
+            auto scanned = clock::now();
+            locate_time = std::min(locate_time, nanoseconds(located - start));
+            scan_time = std::min(scan_time, nanoseconds(scanned - located));
+        }
+        if (std::empty(contained) || !(distance_sum >= 0)) return candidate;
+        candidate.num_queries = std::size(contained);
+        auto num_queries = static_cast<double>(std::size(contained));
+        candidate.probes_per_query = static_cast<double>(num_probes) / num_queries;
+        candidate.probe_time = locate_time / std::max(static_cast<double>(num_probes), 1.);
+        candidate.points_per_query = static_cast<double>(num_scanned) / num_queries;
+        candidate.scan_time = scan_time / num_queries;
+        return candidate;
+    }
+
+    /**
+     * @brief The latencies of dependent reads at random positions of buffers of different sizes,
+     * measured on first use for powers of two bytes
+     *
+     * The largest buffer measured has max_bytes, beyond which reads miss every cache anyway
+     */
+    class read_latencies {
+       public:
+        static constexpr size_t min_bytes = size_t{1} << 12u;
+        static constexpr size_t max_bytes = size_t{1} << 26u;
+
+        /**
+         * @returns How much longer a read from a buffer of to_bytes takes than a read from one of
+         * from_bytes, or 0 if it doesn't
+         */
+        auto extra_latency(double from_bytes, double to_bytes, std::mt19937& generator) -> double {
+            return std::max(latency(to_bytes, generator) - latency(from_bytes, generator), 0.);
+        }
+
+       private:
+        static constexpr size_t line_bytes = 64;
+        static constexpr size_t slots_per_line = line_bytes / sizeof(size_t);
+        static constexpr size_t num_reads = size_t{1} << 16u;
+
+        /** Interpolates the latencies of the powers of two around bytes by log2(bytes) */
+        auto latency(double bytes, std::mt19937& generator) -> double {
+            auto clamped = std::clamp(bytes, static_cast<double>(min_bytes),
+                                      static_cast<double>(max_bytes));
+            auto log_bytes = std::log2(clamped);
+            auto lower = static_cast<unsigned>(std::floor(log_bytes));
+            auto upper = static_cast<unsigned>(std::ceil(log_bytes));
+            auto weight = log_bytes - static_cast<double>(lower);
+            return (1 - weight) * measured(lower, generator) + weight * measured(upper, generator);
+        }
+
+        auto measured(unsigned log_bytes, std::mt19937& generator) -> double {
+            auto& result = latencies_[log_bytes];
+            if (result < 0) {
+                result = measure(size_t{1} << log_bytes, generator);
+            }
+            return result;
+        }
+
+        /** Follows a random cycle through every cache line of a buffer of the given bytes */
+        static auto measure(size_t bytes, std::mt19937& generator) -> double {
+            auto num_lines = bytes / line_bytes;
+            std::vector<size_t> order(num_lines);
+            for (size_t it = 0; it < num_lines; it++) {
+                order[it] = it;
+            }
+            std::shuffle(std::begin(order), std::end(order), generator);
+            std::vector<size_t> next(num_lines * slots_per_line);
+            for (size_t it = 0; it < num_lines; it++) {
+                next[order[it] * slots_per_line] = order[(it + 1) % num_lines] * slots_per_line;
+            }
+            size_t position = 0;
+            auto start = clock::now();
+            for (size_t it = 0; it < num_reads; it++) {
+                position = next[position];
+            }
+            auto elapsed = nanoseconds(clock::now() - start);
+            // Keeps the reads from being optimized out
+            if (position == next.size()) return 0.;
+            return elapsed / static_cast<double>(num_reads);
+        }
+
+        std::array<double, 64> latencies_ = [] {
+            std::array<double, 64> unmeasured{};
+            unmeasured.fill(-1);
+            return unmeasured;
+        }();
+    };
+
+    template <typename duration_type>
+    static auto nanoseconds(duration_type duration) {
+        return static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+};
+
+/**
+ * Convenience wrapper that tunes the splitting condition of a nearest_neighbor_type on the points
+ * in [begin, end) (see splitting_tuner::tune)
+ */
+template <typename nearest_neighbor_type, typename ForwardIterator>
+auto tune_splitting_condition(ForwardIterator begin, ForwardIterator end,
+                              const tuning_options& options = tuning_options{}) {
+    return splitting_tuner<nearest_neighbor_type>::tune(begin, end, options);
+}
+
+}  // namespace implicit_octree_nns
+
+#endif  // IMPLICIT_OCTREE_NNS_SPLITTING_TUNER_HPP
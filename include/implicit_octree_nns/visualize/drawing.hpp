@@ -3,7 +3,9 @@
 
 #include <cassert>
 #include <iostream>
+#include <mutex>
 #include <ostream>
+#include <sstream>
 
 #include "implicit_octree_nns/detail/octree_cell.hpp"
 #include "implicit_octree_nns/detail/utility.hpp"
@@ -55,9 +57,9 @@ struct geometry_drawer {
             *os_ << "octree_cell ";
             *os_ << is_leaf << " ";
             draw_box(cell.box);
-            *os_ << std::size(cell.points) << " ";
-            for (const auto& point : cell.points) {
-                draw_point(point);
+            *os_ << cell.size() << " ";
+            for (size_t it = 0; it < cell.size(); it++) {
+                draw_point(cell.point(it));
                 *os_ << " ";
             }
             *os_ << '\n';
@@ -120,6 +122,27 @@ struct geometry_drawer {
         }
     }
 
+    /**
+     * Calls callback with a drawer that buffers its output, then writes the buffered output in one
+     * piece. Concurrent callers never interleave their output, so this is used to keep the frames
+     * of queries that run on different threads contiguous
+     */
+    template <typename Callback>
+    void draw_atomically(Callback callback) const {
+        if constexpr (do_visualize) {
+            std::ostringstream buffer;
+            geometry_drawer buffered_drawer{};
+            buffered_drawer.os_ = &buffer;
+            buffered_drawer.dimension_ = dimension_;
+            callback(static_cast<const geometry_drawer&>(buffered_drawer));
+
+            static std::mutex output_mutex;
+            std::lock_guard lock{output_mutex};
+            *os_ << buffer.str();
+            std::flush(*os_);
+        }
+    }
+
     geometry_drawer() = default;
     geometry_drawer(std::ostream& os, int dimension) {
         if constexpr (do_visualize) {
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "implicit_octree_nns/detail/experiment_setup.hpp"
+#include "implicit_octree_nns/detail/naive_nearest_neighbor.hpp"
+
+/**
+ * Google Benchmark suite for construction and queries of the octree and its baselines
+ *
+ * Every benchmark is parameterized over the distribution of the point set (see point_distribution),
+ * the number of points and, for the octree, the splitting condition's max_points. Each one is
+ * repeated `repetitions` times, so the reported mean, median, stddev and cv describe the spread
+ * between runs; items_per_second counts points for construction and queries for queries. The
+ * latency benchmarks time every query on its own, and report the p50 and p99 query latency of
+ * each run as counters
+ *
+ * Pass --benchmark_filter to run a subset, eg. --benchmark_filter=query/lattice, and
+ * --benchmark_format=json to compare runs with Google Benchmark's compare.py
+ */
+
+using namespace implicit_octree_nns;
+using namespace implicit_octree_nns::detail;
+
+namespace {
+
+constexpr auto repetitions = 5;
+constexpr auto num_queries = 100000;
+constexpr auto batch_size = 1024;
+constexpr auto generator_seed = 5u;
+
+enum point_distribution { normal, poisson, uniform };
+
+using point_type = model::point<experiment_coord_type, experiment_dimension>;
+
+/** A point set and queries spread uniformly over its bounding box, generated once per argument */
+struct dataset {
+    std::vector<point_type> points;
+    std::vector<point_type> queries;
+    experiment_coord_type max_coord;
+};
+
+auto generate_dataset(int distribution, int num_points) {
+    auto generate = [&](auto distribution_bounds_name) {
+        auto generator = std::mt19937{generator_seed};  // NOLINT
+        auto points = generate_random_points<experiment_dimension>(
+            num_points, generator, std::get<0>(distribution_bounds_name));
+        auto max_coord = get_max_magnitude(std::begin(points), std::end(points));
+        auto queries = generate_random_points<experiment_dimension>(
+            num_queries, generator,
+            std::uniform_real_distribution<experiment_coord_type>(-max_coord, max_coord));
+        return dataset{std::move(points), std::move(queries), max_coord};
+    };
+    switch (distribution) {
+        case normal:
+            return generate(get_normal_distribution(10000.));
+        case poisson:
+            return generate(get_poisson_distribution<experiment_coord_type>(100000000));
+        default:
+            return generate(get_uniform_distribution(34641.));
+    }
+}
+
+const auto& cached_dataset(int distribution, int num_points) {
+    static std::map<std::pair<int, int>, dataset> datasets;
+    auto key = std::pair{distribution, num_points};
+    auto it = datasets.find(key);
+    if (it == std::end(datasets)) {
+        it = datasets.emplace(key, generate_dataset(distribution, num_points)).first;
+    }
+    return it->second;
+}
+
+template <typename locator_type>
+auto build_octree(const dataset& data, int max_points) {
+    auto splitter = splitting_condition{};
+    splitter.max_points = max_points;
+    return locator_type{std::begin(data.points), std::end(data.points), data.max_coord, std::cout,
+                        splitter};
+}
+
+/** Queries reuse one octree per argument, since building it dominates the benchmark otherwise */
+template <typename locator_type>
+const auto& cached_octree(int distribution, int num_points, int max_points) {
+    static std::map<std::tuple<int, int, int>, std::unique_ptr<locator_type>> octrees;
+    auto key = std::tuple{distribution, num_points, max_points};
+    auto& octree = octrees[key];
+    if (!octree) {
+        octree = std::make_unique<locator_type>(
+            build_octree<locator_type>(cached_dataset(distribution, num_points), max_points));
+    }
+    return *octree;
+}
+
+template <template <typename> typename hash_table_model>
+using octree_type = nearest_neighbor<point_type, hash_table_model<point_type>>;
+
+/** Times every query separately, reporting the p50 and p99 latency as counters */
+template <typename locator_type>
+void time_each_query(benchmark::State& state, const dataset& data, locator_type& locator) {
+    std::vector<double> latencies;
+    size_t it = 0;
+    for (auto _ : state) {
+        const auto& query = data.queries[it++ % std::size(data.queries)];
+        auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(locator.find_nearest_neighbor(query));
+        auto end = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration<double>(end - start).count();
+        state.SetIterationTime(elapsed);
+        latencies.push_back(elapsed);
+    }
+    auto percentile = [&](double fraction) {
+        auto rank = fraction * static_cast<double>(std::size(latencies) - 1);
+        auto nth = std::begin(latencies) + static_cast<std::ptrdiff_t>(rank);
+        std::nth_element(std::begin(latencies), nth, std::end(latencies));
+        return *nth * 1e9;
+    };
+    if (!std::empty(latencies)) {
+        state.counters["p50_ns"] = percentile(0.50);
+        state.counters["p99_ns"] = percentile(0.99);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Octree benchmarks, with args (distribution, num_points, max_points)
+
+template <template <typename> typename hash_table_model>
+void octree_construct(benchmark::State& state) {
+    const auto& data = cached_dataset(static_cast<int>(state.range(0)),
+                                      static_cast<int>(state.range(1)));
+    for (auto _ : state) {
+        auto locator =
+            build_octree<octree_type<hash_table_model>>(data, static_cast<int>(state.range(2)));
+        benchmark::DoNotOptimize(locator.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+template <template <typename> typename hash_table_model>
+void octree_query(benchmark::State& state) {
+    auto distribution = static_cast<int>(state.range(0));
+    auto num_points = static_cast<int>(state.range(1));
+    const auto& data = cached_dataset(distribution, num_points);
+    const auto& locator = cached_octree<octree_type<hash_table_model>>(
+        distribution, num_points, static_cast<int>(state.range(2)));
+    size_t it = 0;
+    for (auto _ : state) {
+        const auto& query = data.queries[it++ % std::size(data.queries)];
+        benchmark::DoNotOptimize(locator.find_nearest_neighbor(query));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/** Lattice keyed queries that read the shallow depths from dense arrays */
+void octree_dense_query(benchmark::State& state) {
+    using locator_type = octree_type<model::lattice_hash_table>;
+    static std::map<std::tuple<int, int, int>, std::unique_ptr<locator_type>> octrees;
+    auto distribution = static_cast<int>(state.range(0));
+    auto num_points = static_cast<int>(state.range(1));
+    auto max_points = static_cast<int>(state.range(2));
+    const auto& data = cached_dataset(distribution, num_points);
+    auto& locator = octrees[std::tuple{distribution, num_points, max_points}];
+    if (!locator) {
+        locator = std::make_unique<locator_type>(
+            cached_octree<locator_type>(distribution, num_points, max_points));
+        locator->use_dense_levels();
+    }
+    size_t it = 0;
+    for (auto _ : state) {
+        const auto& query = data.queries[it++ % std::size(data.queries)];
+        benchmark::DoNotOptimize(locator->find_nearest_neighbor(query));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Lattice keyed queries on the point set converted to coordinate_type, reporting the bytes of the
+ * leaf storage per point as a counter to compare the memory of float and double coordinates
+ */
+template <typename coordinate_type>
+void octree_precision_query(benchmark::State& state) {
+    using precision_point_type = model::point<coordinate_type, experiment_dimension>;
+    using locator_type =
+        nearest_neighbor<precision_point_type, model::lattice_hash_table<precision_point_type>>;
+    struct converted_dataset {
+        std::vector<precision_point_type> points;
+        std::vector<precision_point_type> queries;
+        std::unique_ptr<locator_type> locator;
+    };
+    static std::map<std::tuple<int, int, int>, converted_dataset> datasets;
+    auto distribution = static_cast<int>(state.range(0));
+    auto num_points = static_cast<int>(state.range(1));
+    auto max_points = static_cast<int>(state.range(2));
+    auto& converted = datasets[std::tuple{distribution, num_points, max_points}];
+    if (!converted.locator) {
+        const auto& data = cached_dataset(distribution, num_points);
+        auto convert = [](const std::vector<point_type>& points) {
+            auto result = std::vector<precision_point_type>(std::size(points));
+            for (size_t it = 0; it < std::size(points); it++) {
+                for (size_t dim = 0; dim < experiment_dimension; dim++) {
+                    auto coordinate = point_traits<point_type>::get(points[it], dim);
+                    point_traits<precision_point_type>::set(
+                        result[it], dim, static_cast<coordinate_type>(coordinate));
+                }
+            }
+            return result;
+        };
+        converted.points = convert(data.points);
+        converted.queries = convert(data.queries);
+        auto splitter = splitting_condition{};
+        splitter.max_points = max_points;
+        converted.locator = std::make_unique<locator_type>(
+            std::begin(converted.points), std::end(converted.points),
+            static_cast<coordinate_type>(data.max_coord), std::cout, splitter);
+    }
+    const auto& locator = *converted.locator;
+    size_t it = 0;
+    for (auto _ : state) {
+        const auto& query = converted.queries[it++ % std::size(converted.queries)];
+        benchmark::DoNotOptimize(locator.find_nearest_neighbor_index(query));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["leaf_bytes_per_point"] =
+        static_cast<double>(locator.leaf_bytes_used()) / static_cast<double>(num_points);
+}
+
+template <template <typename> typename hash_table_model>
+void octree_query_latency(benchmark::State& state) {
+    auto distribution = static_cast<int>(state.range(0));
+    auto num_points = static_cast<int>(state.range(1));
+    const auto& locator = cached_octree<octree_type<hash_table_model>>(
+        distribution, num_points, static_cast<int>(state.range(2)));
+    time_each_query(state, cached_dataset(distribution, num_points), locator);
+}
+
+template <template <typename> typename hash_table_model>
+void octree_batch_query(benchmark::State& state) {
+    auto distribution = static_cast<int>(state.range(0));
+    auto num_points = static_cast<int>(state.range(1));
+    const auto& data = cached_dataset(distribution, num_points);
+    const auto& locator = cached_octree<octree_type<hash_table_model>>(
+        distribution, num_points, static_cast<int>(state.range(2)));
+    auto results = std::vector<point_type>(batch_size);
+    size_t it = 0;
+    for (auto _ : state) {
+        auto begin = std::begin(data.queries) + static_cast<std::ptrdiff_t>(it);
+        locator.find_nearest_neighbors(begin, begin + batch_size, std::begin(results));
+        benchmark::DoNotOptimize(results.data());
+        benchmark::ClobberMemory();
+        it = (it + batch_size) % (num_queries - batch_size);
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+// Baseline benchmarks, with args (distribution, num_points)
+
+void kd_tree_construct(benchmark::State& state) {
+    const auto& data = cached_dataset(static_cast<int>(state.range(0)),
+                                      static_cast<int>(state.range(1)));
+    for (auto _ : state) {
+        auto locator = kd_tree<point_type>{data.points, generator_seed};
+        benchmark::DoNotOptimize(locator.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+void kd_tree_query_latency(benchmark::State& state) {
+    const auto& data = cached_dataset(static_cast<int>(state.range(0)),
+                                      static_cast<int>(state.range(1)));
+    auto locator = kd_tree<point_type>{data.points, generator_seed};
+    time_each_query(state, data, locator);
+}
+
+void naive_query_latency(benchmark::State& state) {
+    const auto& data = cached_dataset(static_cast<int>(state.range(0)),
+                                      static_cast<int>(state.range(1)));
+    auto locator = naive_nearest_neighbor<point_type>{data.points};
+    time_each_query(state, data, locator);
+}
+
+const std::vector<int64_t> distributions = {normal, poisson, uniform};
+const std::vector<int64_t> point_counts = {10000, 100000, 500000};
+const std::vector<int64_t> max_points_values = {20, 50, 200};
+
+void octree_arguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"distribution", "points", "max_points"})
+        ->ArgsProduct({distributions, point_counts, max_points_values})
+        ->Repetitions(repetitions)
+        ->DisplayAggregatesOnly(true);
+}
+
+void baseline_arguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"distribution", "points"})
+        ->ArgsProduct({distributions, point_counts})
+        ->Repetitions(repetitions)
+        ->DisplayAggregatesOnly(true);
+}
+
+}  // namespace
+
+BENCHMARK(octree_construct<model::hash_table>)
+    ->Name("construct/default")
+    ->Apply(octree_arguments)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(octree_construct<model::lattice_hash_table>)
+    ->Name("construct/lattice")
+    ->Apply(octree_arguments)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(octree_query<model::hash_table>)->Name("query/default")->Apply(octree_arguments);
+BENCHMARK(octree_query<model::flat_hash_table>)->Name("query/flat")->Apply(octree_arguments);
+BENCHMARK(octree_query<model::lattice_hash_table>)->Name("query/lattice")->Apply(octree_arguments);
+BENCHMARK(octree_dense_query)->Name("query/lattice_dense")->Apply(octree_arguments);
+BENCHMARK(octree_precision_query<float>)->Name("query/float")->Apply(octree_arguments);
+BENCHMARK(octree_precision_query<double>)->Name("query/double")->Apply(octree_arguments);
+BENCHMARK(octree_query_latency<model::hash_table>)
+    ->Name("query_latency/default")
+    ->Apply(octree_arguments)
+    ->UseManualTime();
+BENCHMARK(octree_query_latency<model::lattice_hash_table>)
+    ->Name("query_latency/lattice")
+    ->Apply(octree_arguments)
+    ->UseManualTime();
+BENCHMARK(octree_batch_query<model::hash_table>)
+    ->Name("batch_query/default")
+    ->Apply(octree_arguments);
+BENCHMARK(octree_batch_query<model::lattice_hash_table>)
+    ->Name("batch_query/lattice")
+    ->Apply(octree_arguments);
+BENCHMARK(kd_tree_construct)
+    ->Name("construct/kd_tree")
+    ->Apply(baseline_arguments)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(kd_tree_query_latency)
+    ->Name("query_latency/kd_tree")
+    ->Apply(baseline_arguments)
+    ->UseManualTime();
+// The naive baseline scans every point, so it's only run on the smallest point sets
+BENCHMARK(naive_query_latency)
+    ->Name("query_latency/naive")
+    ->ArgNames({"distribution", "points"})
+    ->ArgsProduct({distributions, {point_counts.front()}})
+    ->Repetitions(repetitions)
+    ->DisplayAggregatesOnly(true)
+    ->UseManualTime();
+
+BENCHMARK_MAIN();
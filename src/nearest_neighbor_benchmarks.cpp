@@ -35,4 +35,16 @@ int main() {
     run_experiment(benchmark_generator(get_normal_distribution(10000.)));
     run_experiment(benchmark_generator(get_poisson_distribution<experiment_coord_type>(100000000)));
     run_experiment(benchmark_generator(get_uniform_distribution(34641.)));
+    run_experiment(
+        benchmark_generator<model::flat_hash_table>(get_normal_distribution(10000.), "flat"));
+    run_experiment(benchmark_generator<model::flat_hash_table>(
+        get_poisson_distribution<experiment_coord_type>(100000000), "flat"));
+    run_experiment(
+        benchmark_generator<model::flat_hash_table>(get_uniform_distribution(34641.), "flat"));
+    run_experiment(
+        benchmark_generator<model::lattice_hash_table>(get_normal_distribution(10000.), "lattice"));
+    run_experiment(benchmark_generator<model::lattice_hash_table>(
+        get_poisson_distribution<experiment_coord_type>(100000000), "lattice"));
+    run_experiment(benchmark_generator<model::lattice_hash_table>(get_uniform_distribution(34641.),
+                                                                  "lattice"));
 }
\ No newline at end of file
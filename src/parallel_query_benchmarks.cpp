@@ -0,0 +1,27 @@
+#include <thread>
+
+#include "implicit_octree_nns/detail/experiment_setup.hpp"
+
+using namespace implicit_octree_nns;
+using namespace implicit_octree_nns::detail;
+
+template <typename experiment_type>
+void run_experiment(experiment_type experiment) {
+    constexpr auto num_points = 500000;
+    constexpr auto num_queries = 10000000;
+    constexpr auto max_points = 20;
+    auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        experiment(num_points, num_queries, max_points, num_threads);
+    }
+    if ((max_threads & (max_threads - 1)) != 0) {
+        experiment(num_points, num_queries, max_points, max_threads);
+    }
+}
+
+int main() {
+    run_experiment(parallel_query_generator(get_normal_distribution(10000.)));
+    run_experiment(
+        parallel_query_generator(get_poisson_distribution<experiment_coord_type>(100000000)));
+    run_experiment(parallel_query_generator(get_uniform_distribution(34641.)));
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/hash_table_traits.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+
+using implicit_octree_nns::hash_table_traits;
+using implicit_octree_nns::point_traits;
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::make_point;
+
+using point_type = decltype(make_point(0., 0.));
+using flat_hash_table_type = flat_hash_table<point_type>;
+
+TEST_CASE("Check insert and at for flat model hash table of point depth pairs") {
+    auto pairs =
+        std::vector{std::pair{make_point(0., 3.), 3}, std::pair{make_point(13., -500.), 12},
+                    std::pair{make_point(0., 3.), 0}, std::pair{make_point(0., 0.), 0}};
+    auto values = std::vector{0, -1, 2, 3};
+    assert(std::size(pairs) == std::size(values));
+    flat_hash_table_type ht{};
+    for (size_t it = 0; it < std::size(pairs); it++) {
+        hash_table_traits<flat_hash_table_type>::insert(ht, pairs[it], values[it]);
+    }
+    CHECK(ht.size() == std::size(pairs));
+    for (size_t it = 0; it < std::size(pairs); it++) {
+        auto got = hash_table_traits<flat_hash_table_type>::at(ht, pairs[it]);
+        REQUIRE(got != std::nullopt);
+        CHECK(*got == values[it]);
+    }
+}
+
+TEST_CASE("Check flat model hash table's at with missing values") {
+    flat_hash_table_type ht{};
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1., 2.}, 0}) == std::nullopt);
+    hash_table_traits<flat_hash_table_type>::insert(ht, {{1., 2.}, 0}, 5);
+    auto got = hash_table_traits<flat_hash_table_type>::at(ht, {{1.0, 2.0}, 0});
+    REQUIRE(got != std::nullopt);
+    CHECK(*got == 5);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1., 2.}, 1}) == std::nullopt);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1., 2.}, -1}) == std::nullopt);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1.001, 2.}, 0}) == std::nullopt);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1., 1.999}, 0}) == std::nullopt);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{1., -2.}, 0}) == std::nullopt);
+    CHECK(hash_table_traits<flat_hash_table_type>::at(ht, {{-1., 2.}, 0}) == std::nullopt);
+}
+
+TEST_CASE("Check that the flat model hash table keeps every key when it grows") {
+    constexpr auto num_keys = 10000;
+    flat_hash_table_type ht{};
+    for (int it = 0; it < num_keys; it++) {
+        auto key = std::pair{make_point(static_cast<double>(it % 100), static_cast<double>(it)),
+                             it % 7};
+        hash_table_traits<flat_hash_table_type>::insert(ht, key, it);
+    }
+    CHECK(ht.size() == num_keys);
+    CHECK(ht.size() <= ht.capacity() * flat_hash_table_type::max_load_factor);
+    for (int it = 0; it < num_keys; it++) {
+        auto key = std::pair{make_point(static_cast<double>(it % 100), static_cast<double>(it)),
+                             it % 7};
+        auto got = hash_table_traits<flat_hash_table_type>::at(ht, key);
+        REQUIRE(got != std::nullopt);
+        CHECK(*got == it);
+    }
+
+    auto reserved = flat_hash_table_type{num_keys};
+    auto capacity_before = reserved.capacity();
+    for (int it = 0; it < num_keys; it++) {
+        hash_table_traits<flat_hash_table_type>::insert(
+            reserved, {make_point(static_cast<double>(it), 0.), 0}, it);
+    }
+    CHECK(reserved.capacity() == capacity_before);
+}
+
+TEST_CASE("Check that erasing from the flat model hash table keeps every other key") {
+    constexpr auto num_keys = 10000;
+    using lattice_table_type = implicit_octree_nns::model::lattice_hash_table<point_type>;
+    using traits = hash_table_traits<lattice_table_type>;
+    lattice_table_type ht{};
+    for (int it = 0; it < num_keys; it++) {
+        traits::insert(ht, static_cast<std::uint64_t>(it), it);
+    }
+    for (int it = 0; it < num_keys; it += 3) {
+        traits::erase(ht, static_cast<std::uint64_t>(it));
+    }
+    // Erasing a missing key does nothing
+    traits::erase(ht, std::uint64_t{num_keys});
+    CHECK(ht.size() == num_keys - (num_keys + 2) / 3);
+    for (int it = 0; it < num_keys; it++) {
+        auto got = traits::at(ht, static_cast<std::uint64_t>(it));
+        if (it % 3 == 0) {
+            CHECK(got == std::nullopt);
+        } else {
+            REQUIRE(got != std::nullopt);
+            CHECK(*got == it);
+        }
+    }
+}
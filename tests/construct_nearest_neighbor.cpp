@@ -1,14 +1,23 @@
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <deque>
+#include <limits>
+#include <random>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
 #include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
 #include "implicit_octree_nns/model_point.hpp"
 #include "implicit_octree_nns/nearest_neighbor.hpp"
 
 using implicit_octree_nns::nearest_neighbor;
 
+using implicit_octree_nns::detail::generate_random_points;
+using implicit_octree_nns::detail::get_max_magnitude;
+
 using implicit_octree_nns::model::fpoint2;
 using implicit_octree_nns::model::fpoint3;
 using implicit_octree_nns::model::make_point;
@@ -68,3 +77,169 @@ TEMPLATE_TEST_CASE(
     CHECK(nns.dimension == 3);
     CHECK(nns.construction_set_size() == 4);
 }
+
+TEST_CASE("Testing that multi-threaded construction matches single-threaded construction") {
+    constexpr auto dimension = 2;
+    using implicit_octree_nns::splitting_condition;
+    using point_type = implicit_octree_nns::model::point<double, dimension>;
+
+    constexpr auto num_points = 5000;
+    constexpr auto num_queries = 1000;
+    auto generator = std::mt19937{5u};  // NOLINT
+    auto distribution = std::normal_distribution<double>(0., 10.);
+    auto point_set = generate_random_points<dimension>(num_points, generator, distribution);
+    auto max_coord = get_max_magnitude(std::begin(point_set), std::end(point_set));
+    auto queries = generate_random_points<dimension>(
+        num_queries, generator, std::uniform_real_distribution<double>(-max_coord, max_coord));
+
+    auto serial = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                               max_coord, std::cout, splitting_condition{}, 1};
+    for (unsigned num_threads : {2u, 3u, 8u, 0u}) {
+        auto parallel = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                                     max_coord, std::cout, splitting_condition{},
+                                                     num_threads};
+        CHECK(parallel.size() == serial.size());
+        CHECK(parallel.depth() == serial.depth());
+        CHECK(parallel.octree_hash_table().table.size() ==
+              serial.octree_hash_table().table.size());
+        for (const auto& query_point : queries) {
+            REQUIRE(parallel.find_nearest_neighbor(query_point) ==
+                    serial.find_nearest_neighbor(query_point));
+        }
+    }
+}
+
+TEST_CASE("Testing that construction statistics match the constructed octree") {
+    constexpr auto dimension = 2;
+    using implicit_octree_nns::splitting_condition;
+    using point_type = implicit_octree_nns::model::point<double, dimension>;
+
+    constexpr auto num_points = 5000;
+    auto generator = std::mt19937{5u};  // NOLINT
+    auto distribution = std::normal_distribution<double>(0., 10.);
+    auto point_set = generate_random_points<dimension>(num_points, generator, distribution);
+    auto max_coord = get_max_magnitude(std::begin(point_set), std::end(point_set));
+
+    auto serial = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                               max_coord, std::cout, splitting_condition{}, 1};
+    const auto& stats = serial.build_statistics();
+    REQUIRE(static_cast<int>(std::size(stats.depths)) == serial.depth());
+    REQUIRE(stats.depths.front().cells_processed == 1);
+    REQUIRE(stats.depths.front().points_in_split_cells == num_points);
+    REQUIRE(stats.depths.back().cells_split == 0);
+    for (size_t depth = 0; depth < std::size(stats.depths); depth++) {
+        const auto& level = stats.depths[depth];
+        CHECK(level.cells_split + level.leaves_emitted == level.cells_processed);
+        CHECK(level.points_pushed_to_children >= level.points_in_split_cells);
+        CHECK(level.duplication_factor() >= 1.0);
+        if (depth + 1 < std::size(stats.depths)) {
+            CHECK(stats.depths[depth + 1].cells_processed == (1u << dimension) * level.cells_split);
+        }
+    }
+    auto totals = stats.totals();
+    CHECK(totals.leaves_emitted == serial.size());
+    CHECK(totals.split_time.total() <= stats.total_time);
+
+    auto parallel = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                                 max_coord, std::cout, splitting_condition{}, 4};
+    const auto& parallel_stats = parallel.build_statistics();
+    REQUIRE(std::size(parallel_stats.depths) == std::size(stats.depths));
+    for (size_t depth = 0; depth < std::size(stats.depths); depth++) {
+        CHECK(parallel_stats.depths[depth].cells_split == stats.depths[depth].cells_split);
+        CHECK(parallel_stats.depths[depth].points_pushed_to_children ==
+              stats.depths[depth].points_pushed_to_children);
+    }
+}
+
+TEST_CASE("Testing 3D construction with few points per leaf") {
+    constexpr auto dimension = 3;
+    using implicit_octree_nns::point_traits;
+    using implicit_octree_nns::splitting_condition;
+    using point_type = implicit_octree_nns::model::point<double, dimension>;
+    using traits = point_traits<point_type>;
+
+    auto generator = std::mt19937{17u};  // NOLINT
+    auto check_queries = [&](const auto& locator, const std::vector<point_type>& point_set) {
+        auto queries = generate_random_points<dimension>(
+            200, generator, std::uniform_real_distribution<double>(-0.5, 0.5));
+        for (const auto& query_point : queries) {
+            auto nearest = traits::distance_squared(point_set.front(), query_point);
+            for (const auto& point : point_set) {
+                nearest = std::min(nearest, traits::distance_squared(point, query_point));
+            }
+            auto index = locator.find_nearest_neighbor_index(query_point);
+            REQUIRE(traits::distance_squared(point_set[index], query_point) == nearest);
+        }
+    };
+    auto condition = splitting_condition{};
+    condition.max_points = 8;
+
+    SECTION("Clustered points") {
+        // The cells in the tail of a cluster are reached by many points of the cluster, which
+        // mustn't keep them splitting
+        auto point_set = generate_random_points<dimension>(
+            2000, generator, std::normal_distribution<double>(0, 0.25));
+        auto max_coord = get_max_magnitude(std::begin(point_set), std::end(point_set));
+        auto locator = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                                    max_coord, std::cout, condition};
+        CHECK(locator.depth() < condition.max_depth);
+        check_queries(locator, point_set);
+
+        condition.max_copies_per_point = 16;
+        REQUIRE_THROWS_AS((nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set),
+                                                        max_coord, std::cout, condition}),
+                          std::length_error);
+    }
+    SECTION("Points on a sphere") {
+        // Every child of a cell inside the sphere can hold the nearest neighbor of any point, so
+        // splitting wouldn't separate the points
+        std::vector<point_type> point_set;
+        auto distribution = std::normal_distribution<double>(0, 1);
+        for (int it = 0; it < 100; it++) {
+            auto point = generate_random_points<dimension>(1, generator, distribution).front();
+            auto length = std::sqrt(traits::distance_squared(point, point_type{}));
+            for (size_t dim = 0; dim < dimension; dim++) {
+                traits::set(point, dim, traits::get(point, dim) / length);
+            }
+            point_set.push_back(point);
+        }
+        auto locator = nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set), 2,
+                                                    std::cout, condition};
+        CHECK(locator.size() < std::size(point_set));
+        check_queries(locator, point_set);
+    }
+}
+
+TEST_CASE("Testing the far extent of the splitting condition") {
+    constexpr auto dimension = 3;
+    using implicit_octree_nns::point_traits;
+    using implicit_octree_nns::splitting_condition;
+    using point_type = implicit_octree_nns::model::point<double, dimension>;
+    using traits = point_traits<point_type>;
+
+    // The small cells in the tail of a dense cluster are reached by every point of the cluster
+    // unless the points far outside of them are dropped from their children
+    auto generator = std::mt19937{79u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(3000, generator,
+                                                       std::normal_distribution<double>(0, 2));
+    auto queries = generate_random_points<dimension>(
+        200, generator, std::uniform_real_distribution<double>(-10, 10));
+    auto build = [&](double far_extent) {
+        auto condition = splitting_condition{};
+        condition.far_extent = far_extent;
+        return nearest_neighbor<point_type>{std::begin(point_set), std::end(point_set), 100,
+                                            std::cout, condition};
+    };
+    auto checked = build(0);
+    auto unchecked = build(std::numeric_limits<double>::infinity());
+    auto fallback = build(splitting_condition{}.far_extent);
+    CHECK(checked.leaf_bytes_used() <= fallback.leaf_bytes_used());
+    CHECK(fallback.leaf_bytes_used() < unchecked.leaf_bytes_used());
+    for (const auto& query_point : queries) {
+        auto expected = unchecked.find_nearest_neighbor_with_distance(query_point).distance_squared;
+        for (const auto* locator : {&checked, &fallback}) {
+            auto index = locator->find_nearest_neighbor_index(query_point);
+            REQUIRE(traits::distance_squared(point_set[index], query_point) == expected);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/query_cursor.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::query_cursor;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::point;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/** Checks that every kind of query gives the same results on both data structures */
+template <typename locator_type, typename point_type>
+static void check_same_queries(const locator_type& locator, const locator_type& dense,
+                               const std::vector<point_type>& queries) {
+    auto cursor = query_cursor{dense};
+    for (const auto& query_point : queries) {
+        auto expected = locator.find_nearest_neighbor_index(query_point);
+        REQUIRE(dense.find_nearest_neighbor_index(query_point) == expected);
+        REQUIRE(cursor.find_nearest_neighbor_index(query_point) == expected);
+        auto expected_nearest = locator.find_k_nearest(query_point, 5);
+        auto found_nearest = dense.find_k_nearest(query_point, 5);
+        REQUIRE(std::size(found_nearest) == std::size(expected_nearest));
+        for (size_t it = 0; it < std::size(found_nearest); it++) {
+            REQUIRE(found_nearest[it].index == expected_nearest[it].index);
+        }
+        REQUIRE(dense.count_within_radius(query_point, 5.) ==
+                locator.count_within_radius(query_point, 5.));
+    }
+    auto expected = std::vector<typename locator_type::index_type>(std::size(queries));
+    auto found = std::vector<typename locator_type::index_type>(std::size(queries));
+    locator.find_nearest_neighbor_indices(std::begin(queries), std::end(queries),
+                                          std::begin(expected));
+    dense.find_nearest_neighbor_indices(std::begin(queries), std::end(queries), std::begin(found));
+    REQUIRE(found == expected);
+}
+
+TEST_CASE("Testing dense levels by comparing to hash table lookups") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{79u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(5000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto dense = locator;
+    REQUIRE(dense.dense_depth() == -1);
+    REQUIRE(dense.use_dense_levels() >= 0);
+    REQUIRE(dense.dense_depth() < dense.depth());
+    check_same_queries(locator, dense, queries);
+
+    // Depths 0 to 3 take 1 + 4 + 16 + 64 entries, depth 4 another 256
+    REQUIRE(dense.use_dense_levels(85 * sizeof(int)) == 3);
+    REQUIRE(dense.use_dense_levels(340 * sizeof(int)) == 3);
+    check_same_queries(locator, dense, queries);
+    REQUIRE(dense.use_dense_levels(0) == -1);
+    check_same_queries(locator, dense, queries);
+}
+
+TEST_CASE("Testing 3D dense levels by comparing to hash table lookups") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{83u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(3000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(300, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto dense = locator;
+    // Depths 0 to 2 take 1 + 8 + 64 entries
+    REQUIRE(dense.use_dense_levels(73 * sizeof(int)) == 2);
+    check_same_queries(locator, dense, queries);
+}
+
+TEST_CASE("Testing that dense levels follow insertions and erasures") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{89u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(300, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(700, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(300, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto dense = locator;
+    dense.use_dense_levels(1u << 20u);
+
+    // Insertions split leaves covered by the dense levels, and erasures merge them back
+    for (const auto& new_point : inserted) {
+        REQUIRE(dense.insert(new_point) == locator.insert(new_point));
+    }
+    check_same_queries(locator, dense, queries);
+    for (size_t it = 0; it < std::size(point_set) + std::size(inserted); it += 2) {
+        auto index = static_cast<locator_type::index_type>(it);
+        locator.erase(index);
+        dense.erase(index);
+    }
+    REQUIRE(dense.size() == locator.size());
+    check_same_queries(locator, dense, queries);
+}
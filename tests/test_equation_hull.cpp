@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
 #include "catch2/catch.hpp"
 #include "implicit_octree_nns/detail/equation.hpp"
 #include "implicit_octree_nns/detail/equation_hull.hpp"
@@ -5,6 +11,12 @@
 using implicit_octree_nns::detail::equation;
 using implicit_octree_nns::detail::equation_hull;
 
+/** @returns A copy of the tags viewed by an envelope */
+template <typename Range>
+static auto tags_of(const Range& envelope) {
+    return std::vector<int>(std::begin(envelope), std::end(envelope));
+}
+
 TEST_CASE("Check if trivial hull containing all equations is constructed") {
     equation a{-3., 9.};
     equation b{3., 0.};
@@ -12,7 +24,7 @@ TEST_CASE("Check if trivial hull containing all equations is constructed") {
     std::vector<decltype(a)> equations{a, b, c};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{1, 2, 0});
+    REQUIRE(tags_of(envelope) == std::vector{1, 2, 0});
 }
 
 TEST_CASE("Check if lines are ever excluded when creating equation hull") {
@@ -23,7 +35,7 @@ TEST_CASE("Check if lines are ever excluded when creating equation hull") {
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
 
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{2, 0});
+    REQUIRE(tags_of(envelope) == std::vector{2, 0});
 }
 
 TEST_CASE("Check if lines are ever excluded when creating equation hull 2") {
@@ -33,7 +45,7 @@ TEST_CASE("Check if lines are ever excluded when creating equation hull 2") {
     std::vector<decltype(a)> equations{b, c, a};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{2, 1});
+    REQUIRE(tags_of(envelope) == std::vector{2, 1});
 }
 
 TEST_CASE("Check if lines that are on the lower envelope at exactly one point are kept") {
@@ -43,7 +55,7 @@ TEST_CASE("Check if lines that are on the lower envelope at exactly one point ar
     std::vector<decltype(a)> equations{a, b, c};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{2, 0, 1});
+    REQUIRE(tags_of(envelope) == std::vector{2, 0, 1});
 }
 
 TEST_CASE("Check if equivalent slopes are handled properly") {
@@ -53,7 +65,7 @@ TEST_CASE("Check if equivalent slopes are handled properly") {
     std::vector<decltype(a)> equations{a, b, c};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{0, 2});
+    REQUIRE(tags_of(envelope) == std::vector{0, 2});
 }
 
 TEST_CASE("Check if equivalent slopes are handled properly 2") {
@@ -63,7 +75,7 @@ TEST_CASE("Check if equivalent slopes are handled properly 2") {
     std::vector<decltype(a)> equations{a, b, c};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{2, 1});
+    REQUIRE(tags_of(envelope) == std::vector{2, 1});
 }
 
 TEST_CASE("Check if equivalent slopes are handled properly even if only one equation remains") {
@@ -73,5 +85,99 @@ TEST_CASE("Check if equivalent slopes are handled properly even if only one equa
     std::vector<decltype(a)> equations{a, b, c};
     equation_hull<double, 2> hull(std::begin(equations), std::end(equations));
     auto envelope = hull.lower_envelope();
-    REQUIRE(envelope == std::deque{2});
+    REQUIRE(tags_of(envelope) == std::vector{2});
+}
+
+TEST_CASE("Check if planes that are never lowest are excluded from the 3d hull") {
+    using equation3 = equation<double, 3>;
+    // The lower envelope of the first four planes is -max(|x|, |y|)
+    std::vector<equation3> equations{{1., 0., 0.},  {-1., 0., 0.}, {0., 1., 0.},
+                                     {0., -1., 0.}, {0., 0., 5.},  {0., 0., -0.5}};
+    equation_hull<double, 3> hull(std::begin(equations), std::end(equations));
+    REQUIRE(tags_of(hull.lower_envelope(-1., 1., -1., 1.)) == std::vector{0, 1, 2, 3, 5});
+    REQUIRE(tags_of(hull.lower_envelope(-0.25, 0.25, -0.25, 0.25)) == std::vector{5});
+    REQUIRE(tags_of(hull.lower_envelope(0.6, 1., 0., 0.1)) == std::vector{1});
+}
+
+TEST_CASE("Check if planes that are on the 3d lower envelope at exactly one point are kept") {
+    using equation3 = equation<double, 3>;
+    std::vector<equation3> equations{{1., 0., 0.}, {-1., 0., 0.}, {0., 1., 0.}, {0., 0., 1.}};
+    equation_hull<double, 3> hull(std::begin(equations), std::end(equations));
+    // The envelope is -|x| for y >= 0, which the plane y only touches at x = 0, y = 0
+    REQUIRE(tags_of(hull.lower_envelope(-1., 1., 0., 1.)) == std::vector{0, 1, 2});
+}
+
+TEST_CASE("Check if parallel planes are handled properly in the 3d hull") {
+    using equation3 = equation<double, 3>;
+    std::vector<equation3> equations{{1., 2., 0.}, {1., 2., -1.}, {1., 2., 3.}};
+    equation_hull<double, 3> hull(std::begin(equations), std::end(equations));
+    REQUIRE(tags_of(hull.lower_envelope(-1., 1., -1., 1.)) == std::vector{1});
+}
+
+TEST_CASE("Check if the 3d hull contains the lowest plane at every position") {
+    using equation3 = equation<double, 3>;
+    constexpr auto num_equations = 200;
+    constexpr auto num_steps = 200;
+    constexpr auto lo = -10.;
+    constexpr auto hi = 10.;
+
+    auto generator = std::mt19937{7u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(lo, hi);
+    // Lower envelopes of the distances to points, as built for split planes by octree cells
+    std::vector<equation3> equations;
+    for (int it = 0; it < num_equations; it++) {
+        auto offset = distribution(generator);
+        auto position1 = distribution(generator);
+        auto position2 = distribution(generator);
+        equations.push_back({-2 * position1, -2 * position2,
+                             offset * offset + position1 * position1 + position2 * position2});
+    }
+    equation_hull<double, 3> hull(std::begin(equations), std::end(equations));
+    auto envelope = hull.lower_envelope(lo, hi, lo, hi);
+    auto on_envelope = std::set<int>(std::begin(envelope), std::end(envelope));
+    REQUIRE(std::size(on_envelope) == std::size(envelope));
+    REQUIRE(std::size(envelope) < num_equations);
+
+    for (int step1 = 0; step1 <= num_steps; step1++) {
+        for (int step2 = 0; step2 <= num_steps; step2++) {
+            auto position1 = lo + (hi - lo) * step1 / num_steps;
+            auto position2 = lo + (hi - lo) * step2 / num_steps;
+            auto lowest = std::min_element(
+                std::begin(equations), std::end(equations), [&](const auto& a, const auto& b) {
+                    return a.evaluate_at(position1, position2) <
+                           b.evaluate_at(position1, position2);
+                });
+            REQUIRE(on_envelope.count(std::distance(std::begin(equations), lowest)) == 1);
+        }
+    }
+}
+
+TEST_CASE("Check if rebuilt hulls match freshly constructed hulls") {
+    constexpr auto lo = -10.;
+    constexpr auto hi = 10.;
+    auto generator = std::mt19937{11u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(lo, hi);
+
+    // Shrinking sets of equations leave stale entries in the reused storage
+    equation_hull<double, 2> hull2;
+    equation_hull<double, 3> hull3;
+    for (auto num_equations : {300, 40, 120, 1}) {
+        std::vector<equation<double, 2>> lines;
+        std::vector<equation<double, 3>> planes;
+        for (int it = 0; it < num_equations; it++) {
+            auto offset = distribution(generator);
+            auto position1 = distribution(generator);
+            auto position2 = distribution(generator);
+            lines.push_back({-2 * position1, offset * offset + position1 * position1});
+            planes.push_back({-2 * position1, -2 * position2,
+                              offset * offset + position1 * position1 + position2 * position2});
+        }
+        hull2.build(std::begin(lines), std::end(lines));
+        auto fresh2 = equation_hull<double, 2>(std::begin(lines), std::end(lines));
+        REQUIRE(tags_of(hull2.lower_envelope(lo, hi)) == tags_of(fresh2.lower_envelope(lo, hi)));
+        hull3.build(std::begin(planes), std::end(planes));
+        auto fresh3 = equation_hull<double, 3>(std::begin(planes), std::end(planes));
+        REQUIRE(tags_of(hull3.lower_envelope(lo, hi, lo, hi)) ==
+                tags_of(fresh3.lower_envelope(lo, hi, lo, hi)));
+    }
 }
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/naive_nearest_neighbor.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+
+using implicit_octree_nns::detail::generate_random_points;
+using implicit_octree_nns::detail::naive_nearest_neighbor;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/**
+ * Checks every query against a naive search over the points that weren't erased, which are the
+ * points of point_set whose flag in erased is off
+ */
+template <typename locator_type, typename point_type>
+static void check_queries(const locator_type& locator, const std::vector<point_type>& point_set,
+                          const std::vector<bool>& erased,
+                          const std::vector<point_type>& queries) {
+    std::vector<point_type> remaining;
+    for (size_t it = 0; it < std::size(point_set); it++) {
+        if (!erased[it]) remaining.push_back(point_set[it]);
+    }
+    auto naive_locator = naive_nearest_neighbor{remaining};
+    for (const auto& query_point : queries) {
+        auto expected_nearest_neighbor = naive_locator.find_nearest_neighbor(query_point);
+        auto found_index = locator.find_nearest_neighbor_index(query_point);
+        REQUIRE(!erased[found_index]);
+        auto expected_distance =
+            point_traits<point_type>::distance_squared(expected_nearest_neighbor, query_point);
+        auto found_distance =
+            point_traits<point_type>::distance_squared(locator.point(found_index), query_point);
+        REQUIRE(found_distance == Approx(expected_distance));
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing erased points by comparing to naive nearest neighbor", "",
+                   hash_table<point2>, flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    constexpr auto num_points = 2000;
+    constexpr auto num_queries = 1000;
+    auto generator = std::mt19937{21u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto initial_size = locator.size();
+    auto order = std::vector<size_t>(num_points);
+    std::iota(std::begin(order), std::end(order), size_t{0});
+    std::shuffle(std::begin(order), std::end(order), generator);
+
+    auto erased = std::vector<bool>(num_points);
+    for (size_t it = 0; it < num_points / 2; it++) {
+        auto index = order[it];
+        if (it % 2 == 0) {
+            locator.erase(static_cast<typename locator_type::index_type>(index));
+        } else {
+            REQUIRE(locator.erase(point_set[index]) == index);
+        }
+        erased[index] = true;
+    }
+    check_queries(locator, point_set, erased, queries);
+
+    for (size_t it = num_points / 2; it + 10 < num_points; it++) {
+        locator.erase(static_cast<typename locator_type::index_type>(order[it]));
+        erased[order[it]] = true;
+    }
+    check_queries(locator, point_set, erased, queries);
+    // Leaves emptied by the erasures were merged back into their parents
+    REQUIRE(locator.size() < initial_size);
+
+    auto found = std::vector<point_type>(num_queries);
+    locator.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found));
+    for (size_t it = 0; it < std::size(queries); it++) {
+        REQUIRE(found[it] == locator.find_nearest_neighbor(queries[it]));
+    }
+}
+
+TEST_CASE("Testing points erased from a 3D octree by comparing to naive nearest neighbor") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+
+    auto generator = std::mt19937{23u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto erased = std::vector<bool>(std::size(point_set));
+    for (size_t it = 0; it < std::size(point_set); it += 2) {
+        locator.erase(point_set[it]);
+        erased[it] = true;
+    }
+    check_queries(locator, point_set, erased, queries);
+}
+
+TEST_CASE("Testing interleaved insertions and erasures by comparing to naive nearest neighbor") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{29u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(1500, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(1000, generator, uniform_distribution);
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto erased = std::vector<bool>(std::size(point_set));
+    for (size_t it = 0; it < std::size(inserted); it++) {
+        REQUIRE(locator.insert(inserted[it]) == std::size(point_set));
+        point_set.push_back(inserted[it]);
+        erased.push_back(false);
+        // Erase a random earlier point for every other insertion
+        if (it % 2 == 1) {
+            auto index = std::uniform_int_distribution<size_t>{0, std::size(point_set) - 1}(generator);
+            if (!erased[index]) {
+                locator.erase(static_cast<locator_type::index_type>(index));
+                erased[index] = true;
+            }
+        }
+    }
+    check_queries(locator, point_set, erased, queries);
+
+    // Tombstones are saved with the data structure
+    auto path = (std::filesystem::temp_directory_path() / "implicit_octree_nns_test_erase.bin");
+    locator.save(path.string());
+    auto loaded = locator_type::load(path.string());
+    check_queries(loaded, point_set, erased, queries);
+    REQUIRE(loaded.size() == locator.size());
+    auto first_live = static_cast<size_t>(
+        std::distance(std::begin(erased), std::find(std::begin(erased), std::end(erased), false)));
+    loaded.erase(static_cast<locator_type::index_type>(first_live));
+    erased[first_live] = true;
+    check_queries(loaded, point_set, erased, queries);
+    std::remove(path.string().c_str());
+}
+
+TEST_CASE("Testing that missing points can't be erased") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    auto point_set = std::vector{make_point(-1., -1.), make_point(1., 1.), make_point(1., -1.)};
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    REQUIRE_THROWS_AS(locator.erase(make_point(0., 0.)), std::invalid_argument);
+    REQUIRE_THROWS_AS(locator.erase(3u), std::invalid_argument);
+    locator.erase(0u);
+    REQUIRE_THROWS_AS(locator.erase(0u), std::invalid_argument);
+    REQUIRE_THROWS_AS(locator.erase(point_set[0]), std::invalid_argument);
+    locator.erase(1u);
+    // The last point can't be erased
+    REQUIRE_THROWS_AS(locator.erase(2u), std::invalid_argument);
+    REQUIRE(locator.find_nearest_neighbor(make_point(-1., -1.)) == point_set[2]);
+}
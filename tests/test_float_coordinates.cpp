@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::point;
+
+using point2f = point<float, 2>;
+using point3f = point<float, 3>;
+
+/**
+ * @return The smallest squared distance from query_point to a point of point_set, computed in the
+ * precision of the point type like the octree's own distances
+ */
+template <typename point_type>
+static auto brute_force_distance(const std::vector<point_type>& point_set,
+                                 const point_type& query_point) {
+    auto result = std::numeric_limits<typename point_traits<point_type>::coordinate_type>::max();
+    for (const auto& pt : point_set) {
+        result = std::min(result, point_traits<point_type>::distance_squared(pt, query_point));
+    }
+    return result;
+}
+
+TEMPLATE_TEST_CASE("Testing nearest neighbor queries on 2D float points", "",
+                   hash_table<point2f>, flat_hash_table<point2f>, lattice_hash_table<point2f>) {
+    auto generator = std::mt19937{73u};  // NOLINT
+    auto distribution = std::normal_distribution<float>(0.f, 20.f);
+    auto point_set = generate_random_points<2, float>(5000, generator, distribution);
+    auto queries = generate_random_points<2, float>(
+        500, generator, std::uniform_real_distribution<float>(-100.f, 100.f));
+
+    auto locator = nearest_neighbor<point2f, TestType>(std::begin(point_set), std::end(point_set),
+                                                       100.f);
+    for (const auto& query_point : queries) {
+        // Ties between points are likelier in float, so only the distances are compared
+        auto index = locator.find_nearest_neighbor_index(query_point);
+        REQUIRE(point_traits<point2f>::distance_squared(point_set[index], query_point) ==
+                brute_force_distance(point_set, query_point));
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing nearest neighbor queries on clustered 3D points", "", float, double) {
+    using point_type = point<TestType, 3>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    // Points of a dense cluster end up far outside of the boxes of the small cells in its tail,
+    // which mustn't make those cells keep every point
+    auto generator = std::mt19937{79u};  // NOLINT
+    auto distribution = std::normal_distribution<TestType>(0, 2);
+    auto point_set = generate_random_points<3, TestType>(15000, generator, distribution);
+    auto queries = generate_random_points<3, TestType>(
+        200, generator, std::uniform_real_distribution<TestType>(-10, 10));
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 100);
+    // 3D leaves usually take 25 to 40 times the size of the points, duplicates included
+    REQUIRE(locator.leaf_bytes_used() < 64 * std::size(point_set) * sizeof(point_type));
+    for (const auto& query_point : queries) {
+        auto index = locator.find_nearest_neighbor_index(query_point);
+        REQUIRE(point_traits<point_type>::distance_squared(point_set[index], query_point) ==
+                brute_force_distance(point_set, query_point));
+    }
+}
+
+TEST_CASE("Testing k nearest and radius queries on 3D float points") {
+    using locator_type = nearest_neighbor<point3f, lattice_hash_table<point3f>>;
+
+    auto generator = std::mt19937{83u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<float>(-1.f, 1.f);
+    auto point_set = generate_random_points<3, float>(3000, generator, distribution);
+    auto queries = generate_random_points<3, float>(100, generator, distribution);
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 1.f);
+    constexpr auto k = 8;
+    constexpr auto radius = 0.2f;
+    for (const auto& query_point : queries) {
+        auto distances = std::vector<float>{};
+        for (const auto& pt : point_set) {
+            distances.push_back(point_traits<point3f>::distance_squared(pt, query_point));
+        }
+        std::sort(std::begin(distances), std::end(distances));
+
+        auto k_nearest = locator.find_k_nearest(query_point, k);
+        REQUIRE(std::size(k_nearest) == k);
+        for (size_t it = 0; it < k; it++) {
+            REQUIRE(k_nearest[it].distance_squared == distances[it]);
+        }
+        auto within = std::distance(
+            std::begin(distances),
+            std::upper_bound(std::begin(distances), std::end(distances), radius * radius));
+        REQUIRE(locator.count_within_radius(query_point, radius) == static_cast<size_t>(within));
+    }
+}
+
+TEST_CASE("Float leaves take less memory than double leaves") {
+    auto generator = std::mt19937{89u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-1., 1.);
+    auto point_set = generate_random_points<3>(4000, generator, distribution);
+    auto float_set = std::vector<point3f>{};
+    for (const auto& pt : point_set) {
+        std::array<float, 3> coordinates{};
+        for (size_t dim = 0; dim < 3; dim++) {
+            coordinates[dim] = static_cast<float>(point_traits<point<double, 3>>::get(pt, dim));
+        }
+        float_set.push_back(point3f{coordinates});
+    }
+
+    using double_locator = nearest_neighbor<point<double, 3>, lattice_hash_table<point<double, 3>>>;
+    using float_locator = nearest_neighbor<point3f, lattice_hash_table<point3f>>;
+    auto double_octree = double_locator(std::begin(point_set), std::end(point_set), 1.);
+    auto float_octree = float_locator(std::begin(float_set), std::end(float_set), 1.f);
+    REQUIRE(float_octree.leaf_bytes_used() < double_octree.leaf_bytes_used());
+}
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/naive_nearest_neighbor.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+
+using implicit_octree_nns::detail::generate_random_points;
+using implicit_octree_nns::detail::naive_nearest_neighbor;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/** Checks every query against a naive search over all points, including the inserted ones */
+template <typename locator_type, typename point_type>
+static void check_queries(const locator_type& locator, const std::vector<point_type>& point_set,
+                          const std::vector<point_type>& queries) {
+    auto naive_locator = naive_nearest_neighbor{point_set};
+    for (const auto& query_point : queries) {
+        auto expected_nearest_neighbor = naive_locator.find_nearest_neighbor(query_point);
+        auto found_nearest_neighbor = locator.find_nearest_neighbor(query_point);
+        auto expected_distance =
+            point_traits<point_type>::distance_squared(expected_nearest_neighbor, query_point);
+        auto found_distance =
+            point_traits<point_type>::distance_squared(found_nearest_neighbor, query_point);
+        REQUIRE(found_distance == Approx(expected_distance));
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing inserted points by comparing to naive nearest neighbor", "",
+                   hash_table<point2>, flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    constexpr auto num_initial_points = 500;
+    constexpr auto num_inserted_points = 1500;
+    constexpr auto num_queries = 1000;
+    auto generator_seed = 9u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set =
+        generate_random_points<dimension>(num_initial_points, generator, uniform_distribution);
+    auto inserted =
+        generate_random_points<dimension>(num_inserted_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto initial_size = locator.size();
+    for (const auto& new_point : inserted) {
+        auto index = locator.insert(new_point);
+        REQUIRE(index == std::size(point_set));
+        REQUIRE(locator.point(index) == new_point);
+        REQUIRE(locator.find_nearest_neighbor_index(new_point) == index);
+        point_set.push_back(new_point);
+    }
+    // Leaves that became too large were split
+    REQUIRE(locator.size() > initial_size);
+    check_queries(locator, point_set, queries);
+
+    auto found = std::vector<point_type>(num_queries);
+    locator.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found));
+    for (size_t it = 0; it < std::size(queries); it++) {
+        REQUIRE(found[it] == locator.find_nearest_neighbor(queries[it]));
+    }
+}
+
+TEST_CASE("Testing points inserted into a 3D octree by comparing to naive nearest neighbor") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+
+    auto generator = std::mt19937{13u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    for (const auto& new_point : inserted) {
+        locator.insert(new_point);
+        point_set.push_back(new_point);
+    }
+    check_queries(locator, point_set, queries);
+}
+
+TEST_CASE("Testing points inserted into a mapped nearest neighbor data structure") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{17u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(1000, generator, uniform_distribution);
+
+    auto path = (std::filesystem::temp_directory_path() / "implicit_octree_nns_test_insert.bin");
+    locator_type{std::begin(point_set), std::end(point_set), MAX_COORD}.save(path.string());
+    {
+        auto mapped = locator_type::open_mapped(path.string());
+        auto extended_point_set = point_set;
+        for (const auto& new_point : inserted) {
+            mapped.insert(new_point);
+            extended_point_set.push_back(new_point);
+        }
+        check_queries(mapped, extended_point_set, queries);
+    }
+    // Insertions copy the mapped arrays instead of modifying the file
+    check_queries(locator_type::load(path.string()), point_set, queries);
+    std::remove(path.string().c_str());
+}
+
+TEST_CASE("Testing that points outside of the root box can't be inserted") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    auto generator = std::mt19937{5u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(100, generator, uniform_distribution);
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    REQUIRE_THROWS_AS(locator.insert(make_point(2 * MAX_COORD, 0.)), std::invalid_argument);
+    auto query_point = make_point(MAX_COORD / 2, 0.);
+    REQUIRE(locator.find_nearest_neighbor(query_point) ==
+            naive_nearest_neighbor{point_set}.find_nearest_neighbor(query_point));
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/**
+ * Checks the k nearest neighbors of every query against the sorted distances from the query to
+ * every point of point_set
+ */
+template <typename locator_type, typename point_type>
+static void check_k_nearest(const locator_type& locator, const std::vector<point_type>& point_set,
+                            const std::vector<point_type>& queries, size_t k) {
+    for (const auto& query_point : queries) {
+        auto distances = std::vector<double>{};
+        for (const auto& pt : point_set) {
+            distances.push_back(point_traits<point_type>::distance_squared(pt, query_point));
+        }
+        std::sort(std::begin(distances), std::end(distances));
+
+        auto found = locator.find_k_nearest(query_point, k);
+        REQUIRE(std::size(found) == std::min(k, std::size(point_set)));
+        for (size_t it = 0; it < std::size(found); it++) {
+            REQUIRE(found[it].distance_squared == Approx(distances[it]));
+            REQUIRE(point_traits<point_type>::distance_squared(locator.point(found[it].index),
+                                                               query_point) ==
+                    Approx(found[it].distance_squared));
+        }
+        // Every point is returned at most once
+        std::sort(std::begin(found), std::end(found),
+                  [](const auto& a, const auto& b) { return a.index < b.index; });
+        REQUIRE(std::adjacent_find(std::begin(found), std::end(found), [](const auto& a,
+                                                                         const auto& b) {
+                    return a.index == b.index;
+                }) == std::end(found));
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing k nearest neighbors by comparing to sorted distances", "",
+                   hash_table<point2>, flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    auto generator = std::mt19937{31u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(3000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(300, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    for (auto k : {1, 8, 32}) {
+        check_k_nearest(locator, point_set, queries, k);
+    }
+    // The nearest of the k nearest neighbors is the nearest neighbor
+    for (const auto& query_point : queries) {
+        REQUIRE(locator.find_k_nearest(query_point, 8).front().index ==
+                locator.find_nearest_neighbor_index(query_point));
+    }
+}
+
+TEST_CASE("Testing 3D k nearest neighbors by comparing to sorted distances") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+
+    auto generator = std::mt19937{37u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(2000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+    auto locator = nearest_neighbor<point_type, lattice_hash_table<point_type>>(
+        std::begin(point_set), std::end(point_set), MAX_COORD);
+    for (auto k : {1, 8, 32}) {
+        check_k_nearest(locator, point_set, queries, k);
+    }
+}
+
+TEST_CASE("Testing k nearest neighbors on clustered points") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    // Deep leaves around the cluster border large, shallow leaves
+    auto generator = std::mt19937{41u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(
+        2000, generator, std::normal_distribution<double>(0., MAX_COORD / 50));
+    auto far_points = generate_random_points<dimension>(50, generator, uniform_distribution);
+    point_set.insert(std::end(point_set), std::begin(far_points), std::end(far_points));
+    auto queries = generate_random_points<dimension>(300, generator, uniform_distribution);
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    check_k_nearest(locator, point_set, queries, 16);
+}
+
+TEST_CASE("Testing k nearest neighbors after insertions and erasures") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{43u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    for (const auto& new_point : inserted) {
+        locator.insert(new_point);
+    }
+    auto remaining = std::vector<point_type>{};
+    for (size_t it = 0; it < std::size(point_set); it++) {
+        if (it % 3 == 0) {
+            locator.erase(static_cast<locator_type::index_type>(it));
+        } else {
+            remaining.push_back(point_set[it]);
+        }
+    }
+    remaining.insert(std::end(remaining), std::begin(inserted), std::end(inserted));
+    check_k_nearest(locator, remaining, queries, 24);
+}
+
+TEST_CASE("Testing k nearest neighbors with k out of the usual range") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    auto point_set = std::vector{make_point(-1., -1.), make_point(1., 1.), make_point(1., -1.)};
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    REQUIRE(std::empty(locator.find_k_nearest(make_point(0., 0.), 0)));
+    check_k_nearest(locator, point_set, {make_point(0.5, 0.), make_point(-50., 90.)}, 5);
+    REQUIRE_THROWS_AS(locator.find_k_nearest(make_point(2 * MAX_COORD, 0.), 2),
+                      std::invalid_argument);
+}
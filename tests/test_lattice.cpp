@@ -0,0 +1,58 @@
+#include <set>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/bounding_box.hpp"
+#include "implicit_octree_nns/detail/lattice.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+
+using implicit_octree_nns::detail::bounding_box;
+using implicit_octree_nns::detail::lattice;
+
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+TEST_CASE("Lattice keys of the same point at different depths are distinct") {
+    using point_type = point<double, 2>;
+    auto grid = lattice<point_type>{bounding_box<point_type>(16.0)};
+    auto coordinates = grid.fixed_point(make_point(3.5, -7.25));
+    std::set<std::uint64_t> keys;
+    for (int depth = 0; depth <= lattice<point_type>::max_depth; depth++) {
+        keys.insert(lattice<point_type>::key(coordinates, depth));
+    }
+    CHECK(keys.size() == lattice<point_type>::max_depth + 1);
+    CHECK(lattice<point_type>::key(coordinates, 0) == 1);
+}
+
+TEST_CASE("Lattice keys of 2D points in the same cell match and differ across cells") {
+    using point_type = point<double, 2>;
+    auto grid = lattice<point_type>{bounding_box<point_type>(16.0)};
+    // At depth 2 the cells have length 8, so the cell corners are at -16, -8, 0 and 8
+    CHECK(grid.key(make_point(-15.0, -15.0), 2) == grid.key(make_point(-8.5, -8.5), 2));
+    CHECK(grid.key(make_point(-15.0, -15.0), 2) != grid.key(make_point(-7.5, -15.0), 2));
+    CHECK(grid.key(make_point(-15.0, -15.0), 2) != grid.key(make_point(-15.0, -7.5), 2));
+    CHECK(grid.key(make_point(1.0, 9.0), 2) == grid.key(make_point(7.0, 15.0), 2));
+    // Coordinates are (x, y) = (2, 3), interleaved as y1 x1 y0 x0 = 1110, below the depth tag
+    CHECK(grid.key(make_point(1.0, 9.0), 2) == 0b11110);
+}
+
+TEST_CASE("Lattice keys of 3D points follow the octant ordering of sub_boxes") {
+    using point_type = point<double, 3>;
+    auto box = bounding_box<point_type>(128.0);
+    auto grid = lattice<point_type>{box};
+    auto children = box.sub_boxes();
+    for (std::uint64_t octant = 0; octant < children.size(); octant++) {
+        auto center = make_point(children[octant].mid(0), children[octant].mid(1),
+                                 children[octant].mid(2));
+        CHECK(grid.key(center, 1) == ((1u << 3u) | octant));
+    }
+}
+
+TEST_CASE("Points on or outside the lattice boundary are clamped to the boundary cells") {
+    using point_type = point<double, 2>;
+    auto grid = lattice<point_type>{bounding_box<point_type>(16.0)};
+    auto depth = 10;
+    CHECK(grid.key(make_point(16.0, 16.0), depth) == grid.key(make_point(15.9999, 15.9999), depth));
+    CHECK(grid.key(make_point(16.0, 16.0), depth) == grid.key(make_point(40.0, 20.0), depth));
+    CHECK(grid.key(make_point(-16.0, -16.0), depth) == grid.key(make_point(-17.0, -30.0), depth));
+}
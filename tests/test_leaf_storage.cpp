@@ -0,0 +1,101 @@
+#include <array>
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/leaf_scan.hpp"
+#include "implicit_octree_nns/detail/leaf_storage.hpp"
+#include "implicit_octree_nns/detail/octree_cell.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+
+using implicit_octree_nns::detail::generate_random_points;
+using implicit_octree_nns::detail::detected_simd_level;
+using implicit_octree_nns::detail::leaf_storage;
+using implicit_octree_nns::detail::octree_cell;
+using implicit_octree_nns::detail::scan_closest;
+using implicit_octree_nns::detail::scan_closest_scalar;
+using implicit_octree_nns::detail::simd_level;
+
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+TEST_CASE("Leaf storage keeps the point indices of every leaf contiguous and in order") {
+    using point_type = point<double, 2>;
+    auto point_set = std::vector{make_point(0., 0.), make_point(1., 1.), make_point(2., 2.),
+                                 make_point(-3., 3.), make_point(4., -4.)};
+    auto root = octree_cell<point_type>(std::begin(point_set), std::end(point_set));
+    auto leaves = std::vector{root, root, root};
+    leaves[0].indices = {0, 1};
+    leaves[1].indices = {};
+    leaves[2].indices = {2, 3, 4, 1};
+
+    auto storage = leaf_storage<point_type>{leaves};
+    REQUIRE(storage.num_leaves() == 3);
+    CHECK(storage.size() == 6);
+    CHECK(storage.size(0) == 2);
+    CHECK(storage.size(1) == 0);
+    CHECK(storage.size(2) == 4);
+    using index_type = leaf_storage<point_type>::index_type;
+    CHECK(std::vector<index_type>(storage.begin(0), storage.end(0)) ==
+          std::vector<index_type>{0, 1});
+    CHECK(std::vector<index_type>(storage.begin(2), storage.end(2)) ==
+          std::vector<index_type>{2, 3, 4, 1});
+    for (const auto& leaf : leaves) {
+        CHECK(leaf.indices.empty());
+    }
+
+    CHECK(storage.closest_point(0, make_point(0.9, 0.6)) == make_point(1., 1.));
+    CHECK(storage.closest_point(2, make_point(-2., 2.)) == make_point(-3., 3.));
+    CHECK(storage.closest_point(2, make_point(10., -10.)) == make_point(4., -4.));
+    auto closest = storage.closest(2, make_point(1., 1.5));
+    CHECK(closest.index == 1);
+    CHECK(closest.distance_squared == 0.25);
+}
+
+TEST_CASE("Leaf storage finds the same closest point as the octree cell it was built from") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+
+    auto generator = std::mt19937{5u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-10., 10.);
+    auto point_set = generate_random_points<dimension>(100, generator, distribution);
+    auto queries = generate_random_points<dimension>(100, generator, distribution);
+
+    auto cell = octree_cell<point_type>(std::begin(point_set), std::end(point_set));
+    auto leaves = std::vector{cell};
+    auto storage = leaf_storage<point_type>{leaves};
+    for (const auto& query_point : queries) {
+        REQUIRE(storage.closest_point(0, query_point) == cell.closest_point(query_point));
+    }
+}
+
+TEMPLATE_TEST_CASE("Every supported leaf scan kernel matches the scalar scan", "", float, double) {
+    constexpr auto dimension = size_t{3};
+    auto generator = std::mt19937{7u};  // NOLINT
+    // Few distinct coordinates, so that many points are tied for closest
+    auto distribution = std::uniform_int_distribution<int>(-4, 4);
+
+    auto levels = {simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512};
+    for (auto level : levels) {
+        if (level > detected_simd_level()) {
+            continue;
+        }
+        for (size_t count = 0; count <= 70; count++) {
+            auto coordinates = std::vector<TestType>(dimension * count);
+            for (auto& coordinate : coordinates) {
+                coordinate = static_cast<TestType>(distribution(generator));
+            }
+            for (int trial = 0; trial < 10; trial++) {
+                auto query = std::array<TestType, dimension>{};
+                for (auto& coordinate : query) {
+                    coordinate = static_cast<TestType>(distribution(generator)) / 3;
+                }
+                auto expected = scan_closest_scalar(coordinates.data(), count, query);
+                auto result = scan_closest(level, coordinates.data(), count, query);
+                REQUIRE(result.index == expected.index);
+                REQUIRE(result.distance_squared == expected.distance_squared);
+            }
+        }
+    }
+}
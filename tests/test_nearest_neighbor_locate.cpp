@@ -7,6 +7,7 @@
 #include "catch2/catch.hpp"
 #include "implicit_octree_nns/detail/naive_nearest_neighbor.hpp"
 #include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
 #include "implicit_octree_nns/model_point.hpp"
 #include "implicit_octree_nns/nearest_neighbor.hpp"
 #include "implicit_octree_nns/point_traits.hpp"
@@ -81,6 +82,70 @@ TEST_CASE("Testing 2D octree based nearest neighbor by comparing to naive neares
     });
 }
 
+TEST_CASE("Testing 2D octree based nearest neighbor on the flat hash table") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using hash_table_type = implicit_octree_nns::model::flat_hash_table<point_type>;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 100;
+    auto generator_seed = 5u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto naive_locator = naive_nearest_neighbor{point_set};
+    auto locator = nearest_neighbor<point_type, hash_table_type>(std::begin(point_set),
+                                                                 std::end(point_set), MAX_COORD);
+
+    std::for_each(std::begin(queries), std::end(queries), [&](const auto& query_point) {
+        auto expected_nearest_neighbor = naive_locator.find_nearest_neighbor(query_point);
+        auto found_nearest_neighbor = locator.find_nearest_neighbor(query_point);
+        auto expected_distance =
+            point_traits<point_type>::distance_squared(expected_nearest_neighbor, query_point);
+        auto found_distance =
+            point_traits<point_type>::distance_squared(found_nearest_neighbor, query_point);
+        REQUIRE(found_distance == Approx(expected_distance));
+    });
+}
+
+TEST_CASE("Testing 2D octree based nearest neighbor with lattice keys") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using hash_table_type = implicit_octree_nns::model::lattice_hash_table<point_type>;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 1000;
+    auto generator_seed = 5u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+    // Queries on the boundary of the root box and on the boundaries of the top level cells
+    queries.push_back(make_point(MAX_COORD, MAX_COORD));
+    queries.push_back(make_point(-MAX_COORD, MAX_COORD));
+    queries.push_back(make_point(0., 0.));
+    queries.push_back(make_point(MAX_COORD / 2, -MAX_COORD / 4));
+
+    auto naive_locator = naive_nearest_neighbor{point_set};
+    auto locator = nearest_neighbor<point_type, hash_table_type>(std::begin(point_set),
+                                                                 std::end(point_set), MAX_COORD);
+    auto found = std::vector<point_type>(std::size(queries));
+    locator.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found));
+
+    for (size_t it = 0; it < std::size(queries); it++) {
+        auto expected_nearest_neighbor = naive_locator.find_nearest_neighbor(queries[it]);
+        auto found_nearest_neighbor = locator.find_nearest_neighbor(queries[it]);
+        auto expected_distance =
+            point_traits<point_type>::distance_squared(expected_nearest_neighbor, queries[it]);
+        auto found_distance =
+            point_traits<point_type>::distance_squared(found_nearest_neighbor, queries[it]);
+        REQUIRE(found_distance == Approx(expected_distance));
+        REQUIRE(found[it] == found_nearest_neighbor);
+    }
+}
+
 TEST_CASE("Testing 3D octree based nearest neighbor by comparing to naive nearest neighbor") {
     constexpr auto dimension = 3;
     using point_type = point<double, dimension>;
@@ -120,3 +185,66 @@ TEST_CASE("Testing nearest_neighbor's size() function") {
         REQUIRE(locator.construction_set_size() == num_points);
     }
 }
+
+TEST_CASE("Testing batched nearest neighbor queries by comparing to single queries") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 1000;
+    auto generator_seed = 5u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto found = std::vector<point_type>(num_queries);
+    auto found_end = locator.find_nearest_neighbors(std::begin(queries), std::end(queries),
+                                                    std::begin(found));
+    REQUIRE(found_end == std::end(found));
+    for (size_t it = 0; it < std::size(queries); it++) {
+        REQUIRE(found[it] == locator.find_nearest_neighbor(queries[it]));
+    }
+
+    auto outside_queries = std::vector{make_point(0., 0.), make_point(2 * MAX_COORD, 0.)};
+    CHECK_THROWS_AS(locator.find_nearest_neighbors(std::begin(outside_queries),
+                                                   std::end(outside_queries), std::begin(found)),
+                    std::invalid_argument);
+}
+
+TEST_CASE("Testing nearest neighbor index queries by comparing to point queries") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using index_type = nearest_neighbor<point_type>::index_type;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 1000;
+    auto generator_seed = 7u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto found = std::vector<index_type>(num_queries);
+    locator.find_nearest_neighbor_indices(std::begin(queries), std::end(queries),
+                                          std::begin(found));
+    for (size_t it = 0; it < std::size(queries); it++) {
+        auto index = locator.find_nearest_neighbor_index(queries[it]);
+        REQUIRE(index < num_points);
+        REQUIRE(found[it] == index);
+        REQUIRE(point_set[index] == locator.find_nearest_neighbor(queries[it]));
+        REQUIRE(locator.point(index) == point_set[index]);
+
+        auto [distance_index, distance_squared] =
+            locator.find_nearest_neighbor_with_distance(queries[it]);
+        REQUIRE(distance_index == index);
+        REQUIRE(distance_squared ==
+                point_traits<point_type>::distance_squared(point_set[index], queries[it]));
+    }
+}
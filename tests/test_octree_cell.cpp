@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
 #include "catch2/catch.hpp"
 #include "implicit_octree_nns/detail/axis_aligned.hpp"
 #include "implicit_octree_nns/detail/bounding_box.hpp"
@@ -17,6 +22,7 @@ using implicit_octree_nns::detail::equation;
 using implicit_octree_nns::detail::equation_hull;
 using implicit_octree_nns::detail::generate_random_points;
 using implicit_octree_nns::detail::octree_cell;
+using implicit_octree_nns::detail::split_scratch;
 
 using implicit_octree_nns::model::point;
 
@@ -47,10 +53,10 @@ TEST_CASE(
         return true;
     };
 
-    std::for_each(std::begin(cell.points), std::end(cell.points), [&](const auto& pt) {
-        auto pt_contained_in_bounding_box = point_in_box(pt, cell.box);
+    for (size_t it = 0; it < cell.size(); it++) {
+        auto pt_contained_in_bounding_box = point_in_box(cell.point(it), cell.box);
         REQUIRE(pt_contained_in_bounding_box);
-    });
+    }
 }
 
 TEST_CASE("Check lower envelope with upper/lower bounds for splitting points") {
@@ -73,4 +79,80 @@ TEST_CASE("Check lower envelope with upper/lower bounds for splitting points") {
     const auto& crossed_split_line = hull.lower_envelope(-200., -100.);
     CHECK(std::find(std::begin(crossed_split_line), std::end(crossed_split_line), 0) ==
           std::end(crossed_split_line));
-}
\ No newline at end of file
+}
+TEST_CASE("Check that splits reusing scratch buffers match splits with fresh buffers") {
+    constexpr auto dimension = 2;
+    using coordinate_type = double;
+    using point_type = point<coordinate_type, dimension>;
+
+    auto generator = std::mt19937{97u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(
+        2000, generator, std::uniform_real_distribution<coordinate_type>(-1e3, 1e3));
+    auto root = octree_cell<point_type>(std::begin(point_set), std::end(point_set));
+
+    // Splitting cells of decreasing sizes with the same buffers leaves stale entries behind them
+    auto scratch = split_scratch<point_type>{};
+    std::vector<octree_cell<point_type>> cells{root};
+    for (int depth = 0; depth < 3; depth++) {
+        std::vector<octree_cell<point_type>> children;
+        for (const auto& cell : cells) {
+            auto expected = cell.split_into_children();
+            auto found = cell.split_into_children(nullptr, &scratch);
+            for (size_t it = 0; it < std::size(found); it++) {
+                REQUIRE(found[it].indices == expected[it].indices);
+                REQUIRE(found[it].indices.capacity() == found[it].indices.size());
+                children.push_back(found[it]);
+            }
+        }
+        cells = std::move(children);
+    }
+}
+
+TEST_CASE("Check that splits with inherited sorted positions match splits that sort") {
+    constexpr auto dimension = 2;
+    using coordinate_type = double;
+    using point_type = point<coordinate_type, dimension>;
+
+    // Rounded coordinates make many points share a coordinate, ie. many lines share a slope
+    auto generator = std::mt19937{101u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(
+        3000, generator, std::uniform_real_distribution<coordinate_type>(-1e3, 1e3));
+    for (auto& pt : point_set) {
+        for (auto& coordinate : pt.coordinates_) {
+            coordinate = std::round(coordinate / 8);
+        }
+    }
+    auto by_coordinates = [](const auto& p, const auto& q) {
+        return p.coordinates_ < q.coordinates_;
+    };
+    std::sort(std::begin(point_set), std::end(point_set), by_coordinates);
+    point_set.erase(std::unique(std::begin(point_set), std::end(point_set)), std::end(point_set));
+    auto root = octree_cell<point_type>(std::begin(point_set), std::end(point_set));
+    REQUIRE(root.has_sorted_positions());
+
+    std::vector<octree_cell<point_type>> cells{root};
+    for (int depth = 0; depth < 4; depth++) {
+        std::vector<octree_cell<point_type>> children;
+        for (const auto& cell : cells) {
+            auto unsorted = cell;
+            unsorted.sorted_positions = {};
+            REQUIRE(!unsorted.has_sorted_positions());
+            auto expected = unsorted.split_into_children();
+            auto found = cell.split_into_children();
+            for (size_t it = 0; it < std::size(found); it++) {
+                REQUIRE(found[it].indices == expected[it].indices);
+                REQUIRE(found[it].has_sorted_positions());
+                for (size_t dim = 0; dim < dimension; dim++) {
+                    const auto& positions = found[it].sorted_positions[dim];
+                    REQUIRE(std::is_sorted(
+                        std::begin(positions), std::end(positions), [&](auto a, auto b) {
+                            return point_traits<point_type>::get(found[it].point(a), dim) <
+                                   point_traits<point_type>::get(found[it].point(b), dim);
+                        }));
+                }
+                children.push_back(found[it]);
+            }
+        }
+        cells = std::move(children);
+    }
+}
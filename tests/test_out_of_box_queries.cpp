@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::out_of_box_query;
+using implicit_octree_nns::point_traits;
+using implicit_octree_nns::root_box_policy;
+using implicit_octree_nns::splitting_condition;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+using point3 = point<double, 3>;
+
+/** @return The smallest squared distance from query_point to a point of point_set */
+template <typename point_type>
+static auto brute_force_distance(const std::vector<point_type>& point_set,
+                                 const point_type& query_point) {
+    auto result = point_traits<point_type>::distance_squared(point_set.front(), query_point);
+    for (const auto& pt : point_set) {
+        result = std::min(result, point_traits<point_type>::distance_squared(pt, query_point));
+    }
+    return result;
+}
+
+TEMPLATE_TEST_CASE("Testing non-throwing queries inside of the root box", "", hash_table<point2>,
+                   flat_hash_table<point2>, lattice_hash_table<point2>) {
+    using locator_type = nearest_neighbor<point2, TestType>;
+    static_assert(noexcept(std::declval<const locator_type&>().try_find_nearest_neighbor(
+        std::declval<const point2&>())));
+
+    auto generator = std::mt19937{97u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-1., 1.);
+    auto point_set = generate_random_points<2>(3000, generator, distribution);
+    auto queries = generate_random_points<2>(300, generator, distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set));
+    for (const auto& query_point : queries) {
+        auto expected = locator.find_nearest_neighbor_with_distance(query_point);
+        for (auto mode : {out_of_box_query::reject, out_of_box_query::clamp}) {
+            auto found = locator.try_find_nearest_neighbor(query_point, mode);
+            REQUIRE(found.has_value());
+            REQUIRE(found->index == expected.index);
+            REQUIRE(found->distance_squared == expected.distance_squared);
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing non-throwing queries outside of the root box", "", hash_table<point2>,
+                   flat_hash_table<point2>, lattice_hash_table<point2>) {
+    using locator_type = nearest_neighbor<point2, TestType>;
+
+    auto generator = std::mt19937{101u};  // NOLINT
+    auto distribution = std::normal_distribution<double>(0., 1.);
+    auto point_set = generate_random_points<2>(3000, generator, distribution);
+    // Queries slightly outside of the box, far outside of it, and beyond its corners
+    auto queries = generate_random_points<2>(
+        300, generator, std::uniform_real_distribution<double>(-3., 3.));
+    for (auto [x, y] : {std::pair{1e3, 0.}, std::pair{-50., 70.}, std::pair{0., -1e6}}) {
+        queries.push_back(make_point(x, y));
+    }
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 0, std::cout,
+                                splitting_condition{}, 1, root_box_policy{true});
+    auto num_outside = 0;
+    for (const auto& query_point : queries) {
+        auto inside = locator.try_find_nearest_neighbor(query_point).has_value();
+        num_outside += inside ? 0 : 1;
+        if (!inside) {
+            REQUIRE_THROWS_AS(locator.find_nearest_neighbor_index(query_point),
+                              std::invalid_argument);
+        }
+        auto found = locator.try_find_nearest_neighbor(query_point, out_of_box_query::clamp);
+        REQUIRE(found.has_value());
+        REQUIRE(point_traits<point2>::distance_squared(point_set[found->index], query_point) ==
+                found->distance_squared);
+        REQUIRE(found->distance_squared == brute_force_distance(point_set, query_point));
+    }
+    REQUIRE(num_outside > 0);
+}
+
+TEST_CASE("Testing clamped queries outside of the root box of 3D points") {
+    using locator_type = nearest_neighbor<point3, lattice_hash_table<point3>>;
+
+    auto generator = std::mt19937{103u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-1., 1.);
+    auto point_set = generate_random_points<3>(4000, generator, distribution);
+    auto queries = generate_random_points<3>(
+        200, generator, std::uniform_real_distribution<double>(-1.5, 1.5));
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 1.);
+    for (const auto& query_point : queries) {
+        auto found = locator.try_find_nearest_neighbor(query_point, out_of_box_query::clamp);
+        REQUIRE(found.has_value());
+        REQUIRE(found->distance_squared == brute_force_distance(point_set, query_point));
+    }
+}
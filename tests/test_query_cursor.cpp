@@ -0,0 +1,135 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+#include "implicit_octree_nns/query_cursor.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+using implicit_octree_nns::query_cursor;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/** A random walk of num_steps small steps inside the bounding box, starting at the origin */
+template <int dimension, typename Generator>
+static auto generate_trajectory(size_t num_steps, Generator& generator) {
+    using point_type = point<double, dimension>;
+    auto step_distribution = std::uniform_real_distribution<double>(-0.2, 0.2);
+    auto trajectory = std::vector<point_type>{};
+    auto position = point_type{};
+    for (size_t it = 0; it < num_steps; it++) {
+        for (size_t dim = 0; dim < dimension; dim++) {
+            auto coordinate = point_traits<point_type>::get(position, dim);
+            coordinate += step_distribution(generator);
+            if (coordinate < -MAX_COORD || coordinate > MAX_COORD) coordinate = 0;
+            point_traits<point_type>::set(position, dim, coordinate);
+        }
+        trajectory.push_back(position);
+    }
+    return trajectory;
+}
+
+template <typename locator_type, typename point_type>
+static void check_cursor(const locator_type& locator, const std::vector<point_type>& queries,
+                         query_cursor<locator_type>& cursor) {
+    for (const auto& query_point : queries) {
+        auto expected = locator.find_nearest_neighbor_with_distance(query_point);
+        auto found = cursor.find_nearest_neighbor_with_distance(query_point);
+        REQUIRE(found.index == expected.index);
+        REQUIRE(found.distance_squared == expected.distance_squared);
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing query cursors on trajectories by comparing to single queries", "",
+                   hash_table<point2>, flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    auto generator = std::mt19937{67u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(5000, generator, uniform_distribution);
+    auto trajectory = generate_trajectory<dimension>(20000, generator);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto cursor = query_cursor{locator};
+    REQUIRE(cursor.hit_rate() == 0.);
+    check_cursor(locator, trajectory, cursor);
+    REQUIRE(cursor.num_queries() == std::size(trajectory));
+    // Most steps stay in the same leaf, and the others rarely need more than two lookups
+    CHECK(cursor.hit_rate() > 0.8);
+    CHECK(cursor.num_probes() < 2 * (cursor.num_queries() - cursor.num_hits()) + 100);
+
+    // Unrelated queries are still answered correctly
+    auto queries = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    check_cursor(locator, queries, cursor);
+    cursor.reset();
+    REQUIRE(cursor.find_nearest_neighbor(point_set[7]) == point_set[7]);
+}
+
+TEST_CASE("Testing 3D query cursors on trajectories by comparing to single queries") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{71u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(3000, generator, uniform_distribution);
+    auto trajectory = generate_trajectory<dimension>(5000, generator);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto cursor = query_cursor{locator};
+    check_cursor(locator, trajectory, cursor);
+    CHECK(cursor.hit_rate() > 0.5);
+}
+
+TEST_CASE("Testing query cursors after insertions") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{73u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    auto trajectory = generate_trajectory<dimension>(2000, generator);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+
+    auto cursor = query_cursor{locator};
+    check_cursor(locator, trajectory, cursor);
+    for (const auto& new_point : generate_random_points<dimension>(500, generator,
+                                                                   uniform_distribution)) {
+        locator.insert(new_point);
+    }
+    cursor.reset();
+    check_cursor(locator, trajectory, cursor);
+}
+
+TEST_CASE("Testing that query cursors reject queries outside of the bounding box") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    auto point_set = std::vector{make_point(-1., -1.), make_point(1., 1.), make_point(1., -1.)};
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto cursor = query_cursor{locator};
+    REQUIRE_THROWS_AS(cursor.find_nearest_neighbor(make_point(2 * MAX_COORD, 0.)),
+                      std::invalid_argument);
+    REQUIRE(cursor.num_queries() == 0);
+    REQUIRE(cursor.find_nearest_neighbor(make_point(0.9, 0.8)) == make_point(1., 1.));
+}
@@ -0,0 +1,96 @@
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/query_executor.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::parallel_find_nearest_neighbors;
+using implicit_octree_nns::query_executor;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+TEST_CASE("Testing parallel queries by comparing to single queries") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 5000;
+    auto generator = std::mt19937{5u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto expected = std::vector<point_type>(num_queries);
+    locator.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(expected));
+
+    for (unsigned num_threads : {1u, 2u, 7u, 0u}) {
+        auto executor = query_executor{locator, num_threads};
+        CHECK(executor.num_threads() >= 1);
+        // Reuse the same pool for several batches, including ones smaller than the pool
+        for (size_t batch_size : {size_t{num_queries}, size_t{3}, size_t{0}}) {
+            auto found = std::vector<point_type>(batch_size);
+            auto found_end = executor.find_nearest_neighbors(
+                std::begin(queries), std::next(std::begin(queries), batch_size), std::begin(found));
+            REQUIRE(found_end == std::end(found));
+            for (size_t it = 0; it < batch_size; it++) {
+                REQUIRE(found[it] == expected[it]);
+            }
+        }
+    }
+
+    auto found = std::vector<point_type>(num_queries);
+    parallel_find_nearest_neighbors(locator, std::begin(queries), std::end(queries),
+                                    std::begin(found), 4);
+    CHECK(found == expected);
+}
+
+TEST_CASE("Testing that parallel queries rethrow exceptions from worker threads") {
+    using point_type = point<double, 2>;
+    auto point_set = std::vector{make_point(0., 0.), make_point(1., 1.)};
+    auto locator = nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set));
+    auto queries = std::vector{make_point(0., 0.), make_point(0.5, 0.5), make_point(0.5, 0.5),
+                               make_point(5., 5.)};
+    auto found = std::vector<point_type>(std::size(queries));
+
+    auto executor = query_executor{locator, 4};
+    CHECK_THROWS_AS(
+        executor.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found)),
+        std::invalid_argument);
+    // The pool is still usable after a failed batch
+    executor.find_nearest_neighbors(std::begin(queries), std::prev(std::end(queries)),
+                                    std::begin(found));
+    CHECK(found[1] == make_point(0., 0.));
+}
+
+TEST_CASE("Testing that a failed batch doesn't leak exceptions into the next one") {
+    using point_type = point<double, 2>;
+    auto point_set = std::vector{make_point(0., 0.), make_point(1., 1.)};
+    auto locator = nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set));
+    // Every chunk but the first throws
+    auto queries = std::vector{make_point(0., 0.), make_point(5., 5.), make_point(-5., 5.),
+                               make_point(5., -5.)};
+    auto clean_queries = std::vector{make_point(0., 0.), make_point(0.5, 0.5),
+                                     make_point(0.9, 0.9), make_point(0.1, 0.2)};
+    auto found = std::vector<point_type>(std::size(queries));
+
+    auto executor = query_executor{locator, 4};
+    CHECK_THROWS_AS(
+        executor.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found)),
+        std::invalid_argument);
+    CHECK_NOTHROW(executor.find_nearest_neighbors(std::begin(clean_queries),
+                                                  std::end(clean_queries), std::begin(found)));
+    CHECK(found[2] == make_point(1., 1.));
+}
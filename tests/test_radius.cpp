@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+/**
+ * Checks the points found within radius of every query against the points of point_set within
+ * radius, where the index of point_set[it] is indices[it]
+ */
+template <typename locator_type, typename point_type>
+static void check_within_radius(const locator_type& locator,
+                                const std::vector<point_type>& point_set,
+                                const std::vector<typename locator_type::index_type>& indices,
+                                const std::vector<point_type>& queries, double radius) {
+    using index_type = typename locator_type::index_type;
+    for (const auto& query_point : queries) {
+        auto expected = std::vector<index_type>{};
+        for (size_t it = 0; it < std::size(point_set); it++) {
+            auto distance = point_traits<point_type>::distance_squared(point_set[it], query_point);
+            if (distance <= radius * radius) expected.push_back(indices[it]);
+        }
+        std::sort(std::begin(expected), std::end(expected));
+
+        auto found = std::vector<index_type>{};
+        locator.for_each_within_radius(query_point, radius, [&](const auto& neighbor) {
+            REQUIRE(point_traits<point_type>::distance_squared(locator.point(neighbor.index),
+                                                               query_point) ==
+                    Approx(neighbor.distance_squared));
+            found.push_back(neighbor.index);
+        });
+        // Sorting keeps duplicates, so every point must be reported exactly once
+        std::sort(std::begin(found), std::end(found));
+        REQUIRE(found == expected);
+        REQUIRE(locator.count_within_radius(query_point, radius) == std::size(expected));
+    }
+}
+
+template <typename locator_type, typename point_type>
+static auto identity_indices(const std::vector<point_type>& point_set) {
+    auto indices = std::vector<typename locator_type::index_type>(std::size(point_set));
+    for (size_t it = 0; it < std::size(point_set); it++) {
+        indices[it] = static_cast<typename locator_type::index_type>(it);
+    }
+    return indices;
+}
+
+TEMPLATE_TEST_CASE("Testing radius queries by comparing to brute force", "", hash_table<point2>,
+                   flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    auto generator = std::mt19937{47u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(3000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto indices = identity_indices<locator_type>(point_set);
+    for (auto radius : {0., 0.5, 4., 15., 3 * MAX_COORD}) {
+        check_within_radius(locator, point_set, indices, queries, radius);
+    }
+    // Every point is within a radius of 0 of itself
+    for (size_t it = 0; it < 100; it++) {
+        REQUIRE(locator.count_within_radius(point_set[it], 0.) == 1);
+    }
+}
+
+TEST_CASE("Testing 3D radius queries by comparing to brute force") {
+    constexpr auto dimension = 3;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{53u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(2000, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(100, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto indices = identity_indices<locator_type>(point_set);
+    for (auto radius : {1., 10., 40.}) {
+        check_within_radius(locator, point_set, indices, queries, radius);
+    }
+}
+
+TEST_CASE("Testing radius queries on clustered points") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type>;
+
+    // Deep leaves around the cluster border large, shallow leaves
+    auto generator = std::mt19937{59u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(
+        2000, generator, std::normal_distribution<double>(0., MAX_COORD / 50));
+    auto far_points = generate_random_points<dimension>(50, generator, uniform_distribution);
+    point_set.insert(std::end(point_set), std::begin(far_points), std::end(far_points));
+    auto queries = generate_random_points<dimension>(200, generator,
+                                                     std::normal_distribution<double>(0., 10.));
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto indices = identity_indices<locator_type>(point_set);
+    for (auto radius : {0.1, 2., 30.}) {
+        check_within_radius(locator, point_set, indices, queries, radius);
+    }
+}
+
+TEST_CASE("Testing radius queries after insertions and erasures") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{61u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(1000, generator, uniform_distribution);
+    auto inserted = generate_random_points<dimension>(500, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(200, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto remaining = std::vector<point_type>{};
+    auto indices = std::vector<locator_type::index_type>{};
+    for (const auto& new_point : inserted) {
+        indices.push_back(locator.insert(new_point));
+        remaining.push_back(new_point);
+    }
+    for (size_t it = 0; it < std::size(point_set); it++) {
+        if (it % 3 == 0) {
+            locator.erase(static_cast<locator_type::index_type>(it));
+        } else {
+            remaining.push_back(point_set[it]);
+            indices.push_back(static_cast<locator_type::index_type>(it));
+        }
+    }
+    for (auto radius : {3., 20.}) {
+        check_within_radius(locator, remaining, indices, queries, radius);
+    }
+}
+
+TEST_CASE("Testing radius queries with radii out of the usual range") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+
+    auto point_set = std::vector{make_point(-1., -1.), make_point(1., 1.), make_point(1., -1.)};
+    auto locator =
+        nearest_neighbor<point_type>(std::begin(point_set), std::end(point_set), MAX_COORD);
+    REQUIRE(locator.count_within_radius(make_point(0., 0.), -1.) == 0);
+    REQUIRE(locator.count_within_radius(make_point(0., 0.), 1.) == 0);
+    REQUIRE(locator.count_within_radius(make_point(0., 0.), 2.) == 3);
+    REQUIRE(locator.count_within_radius(make_point(1., 0.), 1.) == 2);
+    REQUIRE_THROWS_AS(locator.count_within_radius(make_point(2 * MAX_COORD, 0.), 1.),
+                      std::invalid_argument);
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/bounding_box.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+using implicit_octree_nns::root_box_policy;
+using implicit_octree_nns::splitting_condition;
+
+using implicit_octree_nns::detail::bounding_box;
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::make_point;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+/** @return The points of point_set scaled by scale along each axis and moved by offset */
+template <typename point_type>
+static auto transform(std::vector<point_type> point_set, const std::vector<double>& scale,
+                      const std::vector<double>& offset) {
+    constexpr auto dimension = point_traits<point_type>::dimension;
+    for (auto& pt : point_set) {
+        std::array<double, dimension> coordinates{};
+        for (size_t dim = 0; dim < dimension; dim++) {
+            coordinates[dim] = point_traits<point_type>::get(pt, dim) * scale[dim] + offset[dim];
+        }
+        pt = point_type{coordinates};
+    }
+    return point_set;
+}
+
+/** @return The index of the point of point_set closest to query_point */
+template <typename point_type>
+static auto brute_force_nearest(const std::vector<point_type>& point_set,
+                                const point_type& query_point) {
+    auto closest = std::min_element(std::begin(point_set), std::end(point_set),
+                                    [&](const auto& a, const auto& b) {
+                                        return point_traits<point_type>::distance_squared(
+                                                   a, query_point) <
+                                               point_traits<point_type>::distance_squared(
+                                                   b, query_point);
+                                    });
+    return std::distance(std::begin(point_set), closest);
+}
+
+TEST_CASE("Fitted bounding boxes contain every point with some padding") {
+    auto point_set = std::vector{make_point(1000., -3.), make_point(1004., 5.), make_point(1002., 1.)};
+    auto box = bounding_box<point2>::fitted(std::begin(point_set), std::end(point_set));
+    for (const auto& pt : point_set) {
+        REQUIRE(box.contains(pt));
+        for (size_t dim = 0; dim < 2; dim++) {
+            REQUIRE(point_traits<point2>::get(pt, dim) < box.max(dim));
+        }
+    }
+    CHECK(box.min(0) == Approx(1000.));
+    CHECK(box.max(0) == Approx(1004.));
+    CHECK(box.min(1) == Approx(-3.));
+    CHECK(box.max(1) == Approx(5.));
+
+    auto padded = bounding_box<point2>::fitted(std::begin(point_set), std::end(point_set), 0.25);
+    CHECK(padded.min(0) == Approx(999.));
+    CHECK(padded.max(0) == Approx(1005.));
+    CHECK(padded.min(1) == Approx(-5.));
+    CHECK(padded.max(1) == Approx(7.));
+}
+
+TEST_CASE("Fitted bounding boxes of degenerate point sets have positive lengths") {
+    // Every point on one line gives the other side the length of the line
+    auto line = std::vector{make_point(-2., 7.), make_point(6., 7.)};
+    auto line_box = bounding_box<point2>::fitted(std::begin(line), std::end(line));
+    CHECK(line_box.length(1) == Approx(line_box.length(0)));
+    CHECK(line_box.mid(1) == Approx(7.));
+    for (const auto& pt : line) {
+        REQUIRE(line_box.contains(pt));
+    }
+
+    auto single = std::vector{make_point(3., 3.)};
+    auto single_box = bounding_box<point2>::fitted(std::begin(single), std::end(single));
+    REQUIRE(single_box.contains(single.front()));
+    for (size_t dim = 0; dim < 2; dim++) {
+        CHECK(single_box.length(dim) > 0.);
+    }
+}
+
+TEMPLATE_TEST_CASE("Testing queries in a root box fitted to points far from the origin", "",
+                   hash_table<point2>, flat_hash_table<point2>, lattice_hash_table<point2>) {
+    using locator_type = nearest_neighbor<point2, TestType>;
+
+    // A thin strip far from the origin, which the cube centered on the origin covers poorly
+    auto generator = std::mt19937{67u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(0., 1.);
+    auto scale = std::vector{40., 1.};
+    auto offset = std::vector{5e3, -2e3};
+    auto point_set =
+        transform(generate_random_points<2>(2000, generator, distribution), scale, offset);
+    auto queries = transform(generate_random_points<2>(300, generator, distribution), scale, offset);
+
+    auto centered = locator_type(std::begin(point_set), std::end(point_set));
+    auto fitted = locator_type(std::begin(point_set), std::end(point_set), 0, std::cout,
+                               splitting_condition{}, 1, root_box_policy{true});
+    REQUIRE(fitted.depth() < centered.depth());
+    for (const auto& query_point : queries) {
+        auto expected = brute_force_nearest(point_set, query_point);
+        REQUIRE(fitted.find_nearest_neighbor_index(query_point) == expected);
+        REQUIRE(centered.find_nearest_neighbor_index(query_point) == expected);
+
+        auto k_nearest = fitted.find_k_nearest(query_point, 5);
+        REQUIRE(std::size(k_nearest) == 5);
+        REQUIRE(k_nearest.front().index == expected);
+        auto within = std::count_if(std::begin(point_set), std::end(point_set), [&](const auto& pt) {
+            return point_traits<point2>::distance_squared(pt, query_point) <= 0.25;
+        });
+        CHECK(fitted.count_within_radius(query_point, 0.5) == static_cast<size_t>(within));
+        CHECK(centered.count_within_radius(query_point, 0.5) == static_cast<size_t>(within));
+    }
+    // Points outside of the fitted box can't be queried, even if the centered cube contains them
+    REQUIRE_THROWS_AS(fitted.find_nearest_neighbor(make_point(0., 0.)), std::invalid_argument);
+}
+
+TEST_CASE("Testing insertions into a padded root box fitted to 3D points") {
+    using point3 = point<double, 3>;
+    using locator_type = nearest_neighbor<point3, lattice_hash_table<point3>>;
+
+    auto generator = std::mt19937{71u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(0., 1.);
+    auto scale = std::vector{10., 300., 2.};
+    auto offset = std::vector{-7e2, 1e2, 3e3};
+    auto point_set =
+        transform(generate_random_points<3>(1000, generator, distribution), scale, offset);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 0, std::cout,
+                                splitting_condition{}, 1, root_box_policy{true, 0.5});
+    // The padding leaves room for points up to half the extent of the initial points away
+    auto inserted = transform(generate_random_points<3>(500, generator,
+                                                        std::uniform_real_distribution<double>(
+                                                            -0.4, 1.4)),
+                              scale, offset);
+    for (const auto& new_point : inserted) {
+        locator.insert(new_point);
+        point_set.push_back(new_point);
+    }
+    auto queries = transform(generate_random_points<3>(200, generator, distribution), scale, offset);
+    for (const auto& query_point : queries) {
+        REQUIRE(locator.find_nearest_neighbor_index(query_point) ==
+                brute_force_nearest(point_set, query_point));
+    }
+}
@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/serialization.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+
+using implicit_octree_nns::detail::serialization::file_header;
+using implicit_octree_nns::detail::serialization::hash_slot_section;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::flat_hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+
+static constexpr auto MAX_COORD = 1e2;
+static const auto uniform_distribution =
+    std::uniform_real_distribution<std::remove_cv_t<decltype(MAX_COORD)>>(-MAX_COORD, MAX_COORD);
+
+static auto temporary_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static auto read_bytes(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+/** Rewrites the header of the index file at path with the given change */
+template <typename Change>
+static auto change_header(const std::string& path, Change change) {
+    file_header header{};
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    change(header);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+TEMPLATE_TEST_CASE("Testing saved nearest neighbor data structures by comparing to the original",
+                   "", flat_hash_table<point2>, lattice_hash_table<point2>) {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, TestType>;
+
+    constexpr auto num_points = 1000;
+    constexpr auto num_queries = 1000;
+    auto generator_seed = 11u;
+
+    auto generator = std::mt19937{generator_seed};  // NOLINT
+    auto point_set = generate_random_points<dimension>(num_points, generator, uniform_distribution);
+    auto queries = generate_random_points<dimension>(num_queries, generator, uniform_distribution);
+
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto path = temporary_path("implicit_octree_nns_test_serialization.bin");
+    locator.save(path);
+
+    auto check_same = [&](const locator_type& restored) {
+        REQUIRE(restored.size() == locator.size());
+        REQUIRE(restored.depth() == locator.depth());
+        REQUIRE(restored.construction_set_size() == locator.construction_set_size());
+        for (const auto& query : queries) {
+            auto index = locator.find_nearest_neighbor_index(query);
+            REQUIRE(restored.find_nearest_neighbor_index(query) == index);
+            REQUIRE(restored.find_nearest_neighbor(query) == point_set[index]);
+        }
+        auto found = std::vector<point_type>(num_queries);
+        restored.find_nearest_neighbors(std::begin(queries), std::end(queries), std::begin(found));
+        for (size_t it = 0; it < std::size(queries); it++) {
+            REQUIRE(found[it] == locator.find_nearest_neighbor(queries[it]));
+        }
+        REQUIRE_THROWS_AS(restored.find_nearest_neighbor(point_type{{2 * MAX_COORD, 0}}),
+                          std::invalid_argument);
+    };
+
+    SECTION("Loading the file") {
+        auto loaded = locator_type::load(path);
+        check_same(loaded);
+        // Copies share the loaded arrays
+        auto copy = loaded;
+        check_same(copy);
+    }
+    SECTION("Mapping the file") {
+        auto mapped = locator_type::open_mapped(path);
+        check_same(mapped);
+        // The mapping outlives the data structure it was opened by as long as a copy uses it
+        auto copy = std::optional<locator_type>{mapped};
+        mapped = locator_type{};
+        check_same(*copy);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Testing that invalid saved nearest neighbor data structures are rejected") {
+    constexpr auto dimension = 2;
+    using point_type = point<double, dimension>;
+    using locator_type = nearest_neighbor<point_type, flat_hash_table<point_type>>;
+    using lattice_locator_type = nearest_neighbor<point_type, lattice_hash_table<point_type>>;
+
+    auto generator = std::mt19937{3u};  // NOLINT
+    auto point_set = generate_random_points<dimension>(100, generator, uniform_distribution);
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), MAX_COORD);
+    auto path = temporary_path("implicit_octree_nns_test_invalid_serialization.bin");
+
+    REQUIRE_THROWS_AS(locator_type::open_mapped(temporary_path("implicit_octree_nns_missing.bin")),
+                      std::runtime_error);
+
+    SECTION("Saved with a different hash table") {
+        locator.save(path);
+        REQUIRE_THROWS_AS(lattice_locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(lattice_locator_type::open_mapped(path), std::runtime_error);
+    }
+    SECTION("Truncated file") {
+        locator.save(path);
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+        REQUIRE_THROWS_AS(locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(locator_type::open_mapped(path), std::runtime_error);
+    }
+    SECTION("Hash table capacity that isn't a power of two") {
+        locator.save(path);
+        change_header(path, [](auto& header) { header.sections[hash_slot_section].count--; });
+        REQUIRE_THROWS_AS(locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(locator_type::open_mapped(path), std::runtime_error);
+    }
+    SECTION("Hash table without empty slots") {
+        locator.save(path);
+        change_header(path, [](auto& header) {
+            header.hash_table_size = header.sections[hash_slot_section].count;
+        });
+        REQUIRE_THROWS_AS(locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(locator_type::open_mapped(path), std::runtime_error);
+    }
+    SECTION("Hash table size that doesn't match its slots") {
+        locator.save(path);
+        change_header(path, [](auto& header) { header.hash_table_size--; });
+        REQUIRE_THROWS_AS(locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(locator_type::open_mapped(path), std::runtime_error);
+    }
+    SECTION("Not an index file") {
+        std::ofstream{path} << "not an index file, but long enough to hold a file header........"
+                            << "................................................................";
+        REQUIRE_THROWS_AS(locator_type::load(path), std::runtime_error);
+        REQUIRE_THROWS_AS(locator_type::open_mapped(path), std::runtime_error);
+    }
+    std::remove(path.c_str());
+}
+
+TEMPLATE_TEST_CASE("Testing that saving the same data structure writes the same bytes", "",
+                   flat_hash_table<point2>, lattice_hash_table<point2>) {
+    using locator_type = nearest_neighbor<point2, TestType>;
+
+    auto generator = std::mt19937{13u};  // NOLINT
+    auto point_set = generate_random_points<2>(1000, generator, uniform_distribution);
+    auto path = temporary_path("implicit_octree_nns_test_deterministic_serialization.bin");
+    auto other_path = temporary_path("implicit_octree_nns_test_deterministic_serialization_2.bin");
+    locator_type(std::begin(point_set), std::end(point_set), MAX_COORD).save(path);
+    locator_type(std::begin(point_set), std::end(point_set), MAX_COORD).save(other_path);
+    REQUIRE(read_bytes(path) == read_bytes(other_path));
+    std::remove(path.c_str());
+    std::remove(other_path.c_str());
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "implicit_octree_nns/detail/utility.hpp"
+#include "implicit_octree_nns/model_flat_hash_table.hpp"
+#include "implicit_octree_nns/model_hash_table.hpp"
+#include "implicit_octree_nns/model_point.hpp"
+#include "implicit_octree_nns/nearest_neighbor.hpp"
+#include "implicit_octree_nns/point_traits.hpp"
+#include "implicit_octree_nns/splitting_tuner.hpp"
+
+using implicit_octree_nns::nearest_neighbor;
+using implicit_octree_nns::point_traits;
+using implicit_octree_nns::tune_splitting_condition;
+using implicit_octree_nns::tuning_options;
+
+using implicit_octree_nns::detail::generate_random_points;
+
+using implicit_octree_nns::model::hash_table;
+using implicit_octree_nns::model::lattice_hash_table;
+using implicit_octree_nns::model::point;
+
+using point2 = point<double, 2>;
+using point3 = point<double, 3>;
+
+/** @return Whether point_index is the index of a closest point of point_set to query_point */
+template <typename point_type>
+static auto is_nearest(const std::vector<point_type>& point_set, const point_type& query_point,
+                       size_t point_index) {
+    auto distance = point_traits<point_type>::distance_squared(point_set[point_index], query_point);
+    return std::none_of(std::begin(point_set), std::end(point_set), [&](const auto& pt) {
+        return point_traits<point_type>::distance_squared(pt, query_point) < distance;
+    });
+}
+
+TEST_CASE("Testing the splitting condition tuned on a sample of 2D points") {
+    using locator_type = nearest_neighbor<point2, lattice_hash_table<point2>>;
+
+    auto generator = std::mt19937{107u};  // NOLINT
+    auto distribution = std::normal_distribution<double>(0., 100.);
+    auto point_set = generate_random_points<2>(20000, generator, distribution);
+    auto options = tuning_options{};
+    options.sample_size = 5000;
+    options.num_queries = 500;
+    options.candidate_max_points = {8, 20, 50, 200};
+    auto tuned = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                        std::end(point_set), options);
+
+    REQUIRE(std::size(tuned.candidates) == std::size(options.candidate_max_points));
+    auto picked = std::find_if(
+        std::begin(tuned.candidates), std::end(tuned.candidates),
+        [&](const auto& candidate) {
+            return candidate.condition.max_points == tuned.condition.max_points;
+        });
+    REQUIRE(picked != std::end(tuned.candidates));
+    for (const auto& candidate : tuned.candidates) {
+        CHECK(candidate.num_queries > 0);
+        CHECK(candidate.predicted_query_time > 0);
+        CHECK(std::isfinite(candidate.predicted_query_time));
+        CHECK(tuned.predicted_query_time <= candidate.predicted_query_time);
+        CHECK(candidate.probes_per_query >= 1);
+        CHECK(candidate.points_per_query > 0);
+    }
+    // Larger leaves make fewer and shallower cells, with fewer copies of each point
+    for (size_t it = 1; it < std::size(tuned.candidates); it++) {
+        CHECK(tuned.candidates[it].num_cells < tuned.candidates[it - 1].num_cells);
+        CHECK(tuned.candidates[it].predicted_bytes < tuned.candidates[it - 1].predicted_bytes);
+    }
+
+    // The memory predicted from the sample is close to that of the whole point set
+    auto locator = locator_type(std::begin(point_set), std::end(point_set), 0, std::cout,
+                                tuned.condition);
+    auto leaf_bytes = static_cast<double>(locator.leaf_bytes_used());
+    CHECK(static_cast<double>(tuned.predicted_bytes) > leaf_bytes);
+    CHECK(static_cast<double>(tuned.predicted_bytes) < 2 * leaf_bytes);
+    auto queries = generate_random_points<2>(200, generator, distribution);
+    for (const auto& query_point : queries) {
+        auto found = locator.try_find_nearest_neighbor(query_point);
+        if (!found) continue;
+        REQUIRE(is_nearest(point_set, query_point, found->index));
+    }
+}
+
+TEST_CASE("Testing the memory limit of the splitting condition tuner") {
+    using locator_type = nearest_neighbor<point2, hash_table<point2>>;
+
+    auto generator = std::mt19937{109u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-1., 1.);
+    auto point_set = generate_random_points<2>(4000, generator, distribution);
+    auto options = tuning_options{};
+    options.num_queries = 200;
+    options.candidate_max_points = {8, 20, 50, 200};
+    auto unlimited = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                            std::end(point_set), options);
+    auto fewest_bytes = std::min_element(
+        std::begin(unlimited.candidates), std::end(unlimited.candidates),
+        [](const auto& a, const auto& b) { return a.predicted_bytes < b.predicted_bytes; });
+
+    // Predicted bytes don't depend on timings, so they're the same for every tuning
+    options.max_bytes = fewest_bytes->predicted_bytes;
+    auto limited = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                          std::end(point_set), options);
+    REQUIRE(limited.condition.max_points == fewest_bytes->condition.max_points);
+    REQUIRE(limited.predicted_bytes == fewest_bytes->predicted_bytes);
+
+    // If no candidate fits, the one taking the fewest bytes is picked
+    options.max_bytes = 1;
+    auto unfit = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                        std::end(point_set), options);
+    REQUIRE(unfit.condition.max_points == fewest_bytes->condition.max_points);
+}
+
+TEST_CASE("Testing the default candidates of the splitting condition tuner on 3D points") {
+    using locator_type = nearest_neighbor<point3, lattice_hash_table<point3>>;
+
+    auto generator = std::mt19937{113u};  // NOLINT
+    auto distribution = std::normal_distribution<double>(0., 1.);
+    auto point_set = generate_random_points<3>(3000, generator, distribution);
+    auto options = tuning_options{};
+    options.num_queries = 200;
+    auto tuned = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                        std::end(point_set), options);
+    REQUIRE(!std::empty(tuned.candidates));
+    for (const auto& candidate : tuned.candidates) {
+        REQUIRE(candidate.condition.max_points >= 16);
+    }
+    REQUIRE(tuned.condition.max_points >= 16);
+}
+
+TEST_CASE("Testing that candidates without timed queries aren't predicted to be free") {
+    using locator_type = nearest_neighbor<point2, lattice_hash_table<point2>>;
+
+    auto generator = std::mt19937{127u};  // NOLINT
+    auto distribution = std::uniform_real_distribution<double>(-1., 1.);
+    auto point_set = generate_random_points<2>(2000, generator, distribution);
+    auto options = tuning_options{};
+    options.num_queries = 0;
+    options.candidate_max_points = {8, 50};
+    auto tuned = tune_splitting_condition<locator_type>(std::begin(point_set),
+                                                        std::end(point_set), options);
+    REQUIRE(std::size(tuned.candidates) == 2);
+    for (const auto& candidate : tuned.candidates) {
+        CHECK(candidate.num_queries == 0);
+        CHECK(std::isinf(candidate.predicted_query_time));
+        CHECK(candidate.predicted_bytes > 0);
+    }
+    CHECK(std::isinf(tuned.predicted_query_time));
+}